@@ -0,0 +1,350 @@
+/*
+Microbenchmarks for the narrowphase tests, the raymath functions they are built on and the
+per-body passes of the step. The kernels of physics_kernels.h run once per scalar type,
+named kernel/float, kernel/double and kernel/fixed. The simulation itself runs the float ones.
+
+  physics-microbench [--filter name] [--min-time seconds]
+
+Each kernel runs over a small input set that stays in L1 (hot) and over a set far larger than
+the last level cache visited in random order (cold). Reports ns/op and millions of ops/sec,
+then the same numbers as JSON on stdout.
+*/
+
+#include "physics.h"
+#include "physics_kernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+static const int HOT_COUNT = 256; // A few KB of input
+static const int COLD_COUNT = 1 << 22; // Tens of MB of input
+
+struct MicroResult
+{
+	std::string name;
+	bool hot;
+	double nsPerOp;
+	double mopsPerSec;
+};
+
+// Random inputs shared by the pairwise kernels
+struct MicroInputs
+{
+	std::vector<Vector2> a, b, normal;
+	std::vector<float> radiusA, radiusB, angle;
+	std::vector<uint32_t> order; // Visit order, shuffled for the cold runs
+
+	MicroInputs(int count, bool shuffle)
+	{
+		uint32_t state = 12345u;
+		auto random = [&]() { state = state * 1664525u + 1013904223u; return (state >> 8) * (1.0f / 16777216.0f); };
+
+		for (int i = 0; i < count; ++i)
+		{
+			a.push_back({ random() * 100.0f, random() * 100.0f });
+			b.push_back({ random() * 100.0f, random() * 100.0f });
+			normal.push_back(Vector2Rotate(Vector2UnitX, random() * 2.0f * PI));
+			radiusA.push_back(5.0f + random() * 30.0f);
+			radiusB.push_back(5.0f + random() * 30.0f);
+			angle.push_back(random() * 2.0f * PI);
+		}
+
+		order.resize(count);
+		std::iota(order.begin(), order.end(), 0u);
+		if (shuffle)
+			for (int i = count - 1; i > 0; --i)
+				std::swap(order[i], order[(uint32_t)(random() * (i + 1)) % (i + 1)]);
+	}
+};
+
+static const char* filter = nullptr; // --filter, only kernels with it in their name run
+
+static bool Wanted(const std::string& name)
+{
+	return filter == nullptr || strstr(name.c_str(), filter) != nullptr;
+}
+
+static volatile float sink; // Keeps the results alive so the work isn't optimized away
+static double minTime = 0.2; // Seconds each measurement runs for at least
+
+// The same inputs in another scalar type, for the precision variants of the kernels
+template <typename T>
+struct RealInputs
+{
+	typedef RealVector2<T> Vector;
+
+	std::vector<Vector> a, b, normal;
+	std::vector<T> radiusA, radiusB;
+	std::vector<uint32_t> order;
+
+	explicit RealInputs(const MicroInputs& in) : order(in.order)
+	{
+		for (size_t i = 0; i < in.a.size(); ++i)
+		{
+			a.push_back(Vector::From(in.a[i]));
+			b.push_back(Vector::From(in.b[i]));
+			normal.push_back(Vector::From(in.normal[i]));
+			radiusA.push_back(T(in.radiusA[i]));
+			radiusB.push_back(T(in.radiusB[i]));
+		}
+	}
+};
+
+// Runs kernel(inputs, i) over every input until minTime has passed
+template <typename Inputs, typename Kernel>
+static MicroResult Measure(const std::string& name, bool hot, const Inputs& inputs, Kernel kernel)
+{
+	using clock = std::chrono::steady_clock;
+	float accumulator = 0.0f;
+	long long ops = 0;
+	double seconds = 0.0;
+	int count = (int)inputs.order.size();
+
+	auto start = clock::now();
+	while (seconds < minTime)
+	{
+		for (int k = 0; k < count; ++k)
+			accumulator += kernel(inputs, inputs.order[k]);
+		ops += count;
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+	}
+	sink = accumulator;
+
+	return { name, hot, seconds * 1e9 / ops, ops / seconds * 1e-6 };
+}
+
+// Whole-array passes, op = one body
+static MicroResult MeasureIntegrate(bool hot)
+{
+	PhysicsSimulation sim;
+	int count = hot ? HOT_COUNT : COLD_COUNT;
+	for (int i = 0; i < count; ++i)
+	{
+		PhysicsBody b;
+		b.position = { (float)(i % 1000), (float)(i / 1000) };
+		b.colliderType = COLLIDER_TYPE_CIRCLE;
+		b.radius = 1.0f;
+		sim.objects.push_back(b);
+	}
+	sim.updateTime();
+	sim.SyncHandles();
+
+	using clock = std::chrono::steady_clock;
+	long long ops = 0;
+	double seconds = 0.0;
+	auto start = clock::now();
+	while (seconds < minTime)
+	{
+		sim.UpdateObjectPositions();
+		ops += count;
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+	}
+	sink = sim.objects[count / 2].position.y;
+
+	return { "UpdateObjectPositions", hot, seconds * 1e9 / ops, ops / seconds * 1e-6 };
+}
+
+// One generator of each type over every body, op = one body through one generator
+static MicroResult MeasureForces(bool hot)
+{
+	PhysicsSimulation sim;
+	int count = hot ? HOT_COUNT : COLD_COUNT;
+	for (int i = 0; i < count; ++i)
+	{
+		PhysicsBodyDef def;
+		def.position = { (float)(i % 1000), (float)(i / 1000) };
+		def.velocity = { (float)(i % 7) - 3.0f, (float)(i % 5) - 2.0f };
+		def.colliderType = COLLIDER_TYPE_CIRCLE;
+		def.collider.circle.radius = 1.0f;
+		def.forceGroups = (uint8_t)(1 << (i % 3));
+		sim.AddBody(def);
+	}
+
+	ForceGenerator g;
+	for (int type = 0; type < FORCE_GENERATOR_COUNT; ++type)
+	{
+		g.type = (ForceGeneratorType)type;
+		g.groups = type < FORCE_ATTRACTOR ? 0xFF : 1 << (type % 3); // Some act on every body, some on a third
+		g.vector = { 500.0f, 500.0f };
+		g.strength = 0.5f;
+		g.radius = 10.0f;
+		g.damping = 0.1f;
+		g.zone = { 0.0f, 0.0f, 500.0f, 500.0f };
+		sim.forceGenerators.push_back(g);
+	}
+
+	using clock = std::chrono::steady_clock;
+	long long ops = 0;
+	double seconds = 0.0;
+	auto start = clock::now();
+	while (seconds < minTime)
+	{
+		sim.AccumulateForces();
+		ops += (long long)count * FORCE_GENERATOR_COUNT;
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+	}
+	sink = sim.Acceleration(count / 2, sim.objects[count / 2].position, sim.objects[count / 2].velocity).x;
+
+	return { "AccumulateForces", hot, seconds * 1e9 / ops, ops / seconds * 1e-6 };
+}
+
+// Semi-implicit Euler over arrays of bodies, every body pulled by gravity times its scale.
+// Straight loops over contiguous arrays, what the compiler can vectorize in each type.
+template <typename T>
+static void IntegrateBatch(RealVector2<T>* positions, RealVector2<T>* velocities, const T* gravityScales, int count, RealVector2<T> gravity, T h)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		velocities[i] += gravity * (gravityScales[i] * h);
+		positions[i] += velocities[i] * h;
+	}
+}
+
+// IntegrateBatch() over arrays of bodies, op = one body
+template <typename T>
+static MicroResult MeasureIntegrateBatch(const std::string& name, bool hot)
+{
+	typedef RealVector2<T> Vector;
+	int count = hot ? HOT_COUNT : COLD_COUNT;
+	std::vector<Vector> positions, velocities;
+	std::vector<T> gravityScales(count, T(1));
+	for (int i = 0; i < count; ++i)
+	{
+		positions.push_back(Vector::From({ (float)(i % 1000), (float)(i / 1000) }));
+		velocities.push_back(Vector::From(Vector2Zeros));
+	}
+
+	// Gravity flips every pass so the bodies stay put, fixed point has a range to keep to
+	Vector gravity = Vector::From({ 0.0f, 9.81f });
+	Vector flipped = Vector::From({ 0.0f, -9.81f });
+	T h = T(1.0f / 50.0f);
+
+	using clock = std::chrono::steady_clock;
+	long long ops = 0;
+	double seconds = 0.0;
+	auto start = clock::now();
+	while (seconds < minTime)
+	{
+		IntegrateBatch(positions.data(), velocities.data(), gravityScales.data(), count, (ops / count) & 1 ? flipped : gravity, h);
+		ops += count;
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+	}
+	sink = (float)positions[count / 2].y;
+
+	return { name, hot, seconds * 1e9 / ops, ops / seconds * 1e-6 };
+}
+
+// Every kernel of physics_kernels.h and the batch integration in scalar type T
+template <typename T>
+static void RunPrecision(bool hot, const MicroInputs& inputs, std::vector<MicroResult>& results)
+{
+	typedef RealVector2<T> Vector;
+	std::string suffix = std::string("/") + RealName<T>();
+	RealInputs<T> real(inputs);
+
+	if (Wanted("CircleCircle" + suffix))
+		results.push_back(Measure("CircleCircle" + suffix, hot, real, [](const RealInputs<T>& in, uint32_t i)
+		{
+			Vector mtv = {};
+			return PhysicsKernels<T>::CircleCircle(in.a[i], in.radiusA[i], in.b[i], in.radiusB[i], &mtv) + (float)mtv.x;
+		}));
+
+	if (Wanted("CircleHalfSpace" + suffix))
+		results.push_back(Measure("CircleHalfSpace" + suffix, hot, real, [](const RealInputs<T>& in, uint32_t i)
+		{
+			Vector mtv = {};
+			return PhysicsKernels<T>::CircleHalfSpace(in.a[i], in.radiusA[i], in.b[i], in.normal[i], &mtv) + (float)mtv.x;
+		}));
+
+	if (Wanted("IntegrateBatch" + suffix))
+		results.push_back(MeasureIntegrateBatch<T>("IntegrateBatch" + suffix, hot));
+}
+
+static void RunAll(std::vector<MicroResult>& results)
+{
+	auto wanted = [](const char* name) { return Wanted(name); };
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool hot = pass == 0;
+		MicroInputs inputs(hot ? HOT_COUNT : COLD_COUNT, !hot);
+
+		if (wanted("CircleCircle"))
+			results.push_back(Measure("CircleCircle", hot, inputs, [](const MicroInputs& in, uint32_t i)
+			{
+				Vector2 mtv = Vector2Zeros;
+				return PhysicsSimulation::CircleCircle(in.a[i], in.radiusA[i], in.b[i], in.radiusB[i], &mtv) + mtv.x;
+			}));
+
+		if (wanted("CircleHalfSpace"))
+			results.push_back(Measure("CircleHalfSpace", hot, inputs, [](const MicroInputs& in, uint32_t i)
+			{
+				Vector2 mtv = Vector2Zeros;
+				return PhysicsSimulation::CircleHalfSpace(in.a[i], in.radiusA[i], in.b[i], in.normal[i], &mtv) + mtv.x;
+			}));
+
+		if (wanted("Vector2Normalize"))
+			results.push_back(Measure("Vector2Normalize", hot, inputs, [](const MicroInputs& in, uint32_t i)
+			{
+				return Vector2Normalize(in.a[i]).x;
+			}));
+
+		if (wanted("Vector2Distance"))
+			results.push_back(Measure("Vector2Distance", hot, inputs, [](const MicroInputs& in, uint32_t i)
+			{
+				return Vector2Distance(in.a[i], in.b[i]);
+			}));
+
+		if (wanted("Vector2Rotate"))
+			results.push_back(Measure("Vector2Rotate", hot, inputs, [](const MicroInputs& in, uint32_t i)
+			{
+				return Vector2Rotate(in.a[i], in.angle[i]).y;
+			}));
+
+		if (wanted("UpdateObjectPositions"))
+			results.push_back(MeasureIntegrate(hot));
+
+		if (wanted("AccumulateForces"))
+			results.push_back(MeasureForces(hot));
+
+		RunPrecision<float>(hot, inputs, results);
+		RunPrecision<double>(hot, inputs, results);
+		RunPrecision<Fixed64>(hot, inputs, results);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			minTime = atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	std::vector<MicroResult> results;
+	RunAll(results);
+
+	for (const MicroResult& r : results)
+		fprintf(stderr, "%-24s %-4s %9.2f ns/op %10.1f Mops/s\n", r.name.c_str(), r.hot ? "hot" : "cold", r.nsPerOp, r.mopsPerSec);
+
+	printf("{\n  \"microbenchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const MicroResult& r = results[i];
+		printf("    { \"name\": \"%s\", \"cache\": \"%s\", \"ns_per_op\": %.3f, \"mops_per_sec\": %.3f }%s\n",
+			r.name.c_str(), r.hot ? "hot" : "cold", r.nsPerOp, r.mopsPerSec, i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,597 @@
+/*
+Scene-level benchmarks for the simulation.
+
+  physics-bench [--scenes funnel,rain,...] [--sizes 1000,10000,100000] [--steps N] [--warmup N]
+                [--integrator euler|verlet|pbd|rk4] [--reorder]
+                [--out results.json] [--baseline results.json] [--threshold 0.10]
+  physics-bench --accuracy
+  physics-bench --arena
+
+Every scene from STRESS_SCENES runs at every size. Results are printed as JSON (and written to --out).
+The simulation steps in float, physics-microbench compares the kernels in float, double and fixed point.
+With --baseline the run is compared against a saved result, any scenario whose steps/sec dropped by
+more than the threshold is reported and the exit code is 1. So is any scenario whose timed steps
+allocated from the heap, arena chunks included: after the warmup a step runs out of the simulation's
+scratch arena, the grid's arena and the capacity earlier steps left behind.
+
+--arena only runs the checks of the scratch arena every run starts with: marks and rewinds, chunks
+merged by Reset(), ScratchArray keeping its elements as it grows, sub-arenas filled by several threads at
+once and reset with their parent. A failed check also makes the exit code 1.
+
+--accuracy flies a projectile with every integrator at several step rates and compares it to the
+analytic arc, along with what integrating a body costs.
+*/
+
+#include "physics.h"
+#include "scenes.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <psapi.h>
+#endif
+
+// Every heap allocation in the process, operator new is replaced below to count them
+static std::atomic<long long> heapAllocations{ 0 };
+
+void* operator new(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = malloc(size > 0 ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Scratch arena chunks count too, the grid and the step's scratch get theirs this way
+static void* CountedMalloc(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size);
+}
+
+struct BenchResult
+{
+	std::string name;
+	int bodies = 0;
+	int steps = 0;
+	double stepsPerSec = 0.0;
+	double p50Ms = 0.0;
+	double p99Ms = 0.0;
+	PhysicsStepTimings phases; // Average per step
+	long long peakMemoryKb = 0;
+	double allocationsPerStep = 0.0; // Heap allocations during the timed steps, 0 in steady state
+	long long scratchBytes = 0; // High-water mark of the scratch arena
+	double snapshotMs = 0.0; // SaveSnapshot() of the final state
+	double restoreMs = 0.0;
+};
+
+// Starts a new peak memory measurement where the platform allows it
+static void ResetPeakMemory()
+{
+#if defined(__linux__)
+	// Writing 5 resets the peak resident set size (VmHWM)
+	if (FILE* f = fopen("/proc/self/clear_refs", "w"))
+	{
+		fputs("5", f);
+		fclose(f);
+	}
+#endif
+}
+
+static long long PeakMemoryKb()
+{
+#if defined(__linux__)
+	long long kb = 0;
+	if (FILE* f = fopen("/proc/self/status", "r"))
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), f))
+			if (sscanf(line, "VmHWM: %lld kB", &kb) == 1)
+				break;
+		fclose(f);
+	}
+	return kb;
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (long long)(counters.PeakWorkingSetSize / 1024);
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+static double Percentile(std::vector<double> samples, double p)
+{
+	if (samples.empty())
+		return 0.0;
+	size_t k = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+	return samples[k];
+}
+
+static BenchResult RunScenario(const StressScene& scene, int bodies, int steps, int warmup, IntegratorType integrator, bool reorder)
+{
+	ResetPeakMemory();
+
+	PhysicsSimulation sim;
+	scene.build(sim, bodies);
+	sim.recordTimings = true;
+	sim.integrator = integrator;
+	sim.reorderEnabled = reorder;
+
+	const float dt = 1.0f / PhysicsSimulation::TARGET_FPS;
+	for (int i = 0; i < warmup; ++i)
+		sim.Step(dt);
+
+	BenchResult result;
+	result.name = std::string(scene.name) + "/" + std::to_string(bodies);
+	result.bodies = bodies;
+	result.steps = steps;
+
+	std::vector<double> stepMs;
+	stepMs.reserve(steps);
+	long long allocationsBefore = heapAllocations.load();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; ++i)
+	{
+		auto stepStart = std::chrono::steady_clock::now();
+		sim.Step(dt);
+		stepMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count());
+
+		result.phases.integrateMs += sim.lastTimings.integrateMs / steps;
+		result.phases.broadphaseMs += sim.lastTimings.broadphaseMs / steps;
+		result.phases.narrowphaseMs += sim.lastTimings.narrowphaseMs / steps;
+		result.phases.resolveMs += sim.lastTimings.resolveMs / steps;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.allocationsPerStep = (double)(heapAllocations.load() - allocationsBefore) / steps;
+	result.scratchBytes = (long long)sim.ScratchHighWaterMark();
+
+	result.stepsPerSec = steps / seconds;
+	result.p50Ms = Percentile(stepMs, 0.50);
+	result.p99Ms = Percentile(stepMs, 0.99);
+	result.peakMemoryKb = PeakMemoryKb();
+
+	// Rollback cost, after the memory reading so the snapshot buffer doesn't count
+	const int rounds = 20;
+	std::vector<unsigned char> snapshot;
+	sim.SaveSnapshot(snapshot);
+	auto snapshotStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i)
+		sim.SaveSnapshot(snapshot);
+	auto restoreStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i)
+		sim.RestoreSnapshot(snapshot.data(), snapshot.size());
+	auto restoreEnd = std::chrono::steady_clock::now();
+	result.snapshotMs = std::chrono::duration<double, std::milli>(restoreStart - snapshotStart).count() / rounds;
+	result.restoreMs = std::chrono::duration<double, std::milli>(restoreEnd - restoreStart).count() / rounds;
+	return result;
+}
+
+struct AccuracyResult
+{
+	IntegratorType integrator;
+	int stepsPerSecond;
+	double maxErrorPx; // Furthest the body got from the analytic arc
+	double finalErrorPx;
+	double nsPerBody; // UpdateObjectPositions() per body and step
+};
+
+static AccuracyResult RunAccuracy(IntegratorType integrator, int stepsPerSecond)
+{
+	// A launch like the game's: 150 px/s at 45 degrees, flying for 5 seconds
+	const Vector2 start = { 0.0f, 0.0f };
+	const Vector2 velocity = { 106.07f, -106.07f };
+	const float flightTime = 5.0f;
+	const float dt = 1.0f / stepsPerSecond;
+
+	PhysicsSimulation sim;
+	sim.integrator = integrator;
+	PhysicsBody body;
+	body.position = start;
+	body.velocity = velocity;
+	body.colliderType = COLLIDER_TYPE_CIRCLE;
+	body.radius = 1.0f;
+	sim.objects.push_back(body);
+
+	AccuracyResult result = { integrator, stepsPerSecond, 0.0, 0.0, 0.0 };
+	int steps = (int)(flightTime * stepsPerSecond + 0.5f);
+	for (int i = 1; i <= steps; ++i)
+	{
+		sim.Step(dt);
+
+		// In double so the reference doesn't add float error of its own
+		double t = (double)i * dt;
+		double x = start.x + velocity.x * t;
+		double y = start.y + velocity.y * t + 0.5 * sim.gravity.y * t * t;
+		double error = std::hypot(sim.objects[0].position.x - x, sim.objects[0].position.y - y);
+		result.maxErrorPx = std::max(result.maxErrorPx, error);
+		result.finalErrorPx = error;
+	}
+
+	// Cost on its own, without the collision phases
+	const int count = 100000;
+	const int rounds = 50;
+	sim.objects.assign(count, body);
+	sim.SyncHandles();
+	auto costStart = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i)
+		sim.UpdateObjectPositions();
+	result.nsPerBody = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - costStart).count() / ((double)count * rounds);
+	return result;
+}
+
+static void WriteAccuracyJson(const std::vector<AccuracyResult>& results, FILE* out)
+{
+	fprintf(out, "{\n  \"accuracy\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const AccuracyResult& r = results[i];
+		fprintf(out, "    { \"integrator\": \"%s\", \"steps_per_sec\": %d, \"max_error_px\": %.6f, \"final_error_px\": %.6f, \"ns_per_body\": %.3f }%s\n",
+			PhysicsSimulation::IntegratorName(r.integrator), r.stepsPerSecond, r.maxErrorPx, r.finalErrorPx, r.nsPerBody,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+static int RunAccuracyBench()
+{
+	const int rates[] = { 50, 30, 25 };
+
+	std::vector<AccuracyResult> results;
+	for (int i = 0; i < INTEGRATOR_COUNT; ++i)
+	{
+		for (int rate : rates)
+		{
+			results.push_back(RunAccuracy((IntegratorType)i, rate));
+			const AccuracyResult& r = results.back();
+			fprintf(stderr, "%-8s %3d Hz  max error %10.6f px  final %10.6f px  %6.2f ns/body\n",
+				PhysicsSimulation::IntegratorName(r.integrator), r.stepsPerSecond, r.maxErrorPx, r.finalErrorPx, r.nsPerBody);
+		}
+	}
+
+	WriteAccuracyJson(results, stdout);
+	return 0;
+}
+
+static void WriteJson(const std::vector<BenchResult>& results, FILE* out)
+{
+	fprintf(out, "{\n  \"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& r = results[i];
+		fprintf(out,
+			"    { \"name\": \"%s\", \"bodies\": %d, \"steps\": %d, \"steps_per_sec\": %.3f, \"p50_ms\": %.4f, \"p99_ms\": %.4f,\n"
+			"      \"phase_ms\": { \"integrate\": %.4f, \"broadphase\": %.4f, \"narrowphase\": %.4f, \"resolve\": %.4f },\n"
+			"      \"peak_memory_kb\": %lld, \"allocs_per_step\": %.3f, \"scratch_bytes\": %lld, \"snapshot_ms\": %.4f, \"restore_ms\": %.4f }%s\n",
+			r.name.c_str(), r.bodies, r.steps, r.stepsPerSec, r.p50Ms, r.p99Ms,
+			r.phases.integrateMs, r.phases.broadphaseMs, r.phases.narrowphaseMs, r.phases.resolveMs,
+			r.peakMemoryKb, r.allocationsPerStep, r.scratchBytes, r.snapshotMs, r.restoreMs, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+// Reads back the name and steps/sec of every entry written by WriteJson
+static bool ReadBaseline(const char* path, std::vector<BenchResult>& baseline)
+{
+	FILE* f = fopen(path, "rb");
+	if (f == nullptr)
+		return false;
+
+	std::string text;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		text.append(buffer, n);
+	fclose(f);
+
+	size_t pos = 0;
+	while ((pos = text.find("\"name\": \"", pos)) != std::string::npos)
+	{
+		pos += 9;
+		size_t end = text.find('"', pos);
+		size_t sps = text.find("\"steps_per_sec\": ", end);
+		if (end == std::string::npos || sps == std::string::npos)
+			break;
+
+		BenchResult r;
+		r.name = text.substr(pos, end - pos);
+		r.stepsPerSec = atof(text.c_str() + sps + 17);
+		baseline.push_back(r);
+		pos = sps;
+	}
+	return true;
+}
+
+static std::vector<std::string> SplitList(const char* list)
+{
+	std::vector<std::string> items;
+	std::string current;
+	for (const char* c = list; ; ++c)
+	{
+		if (*c == ',' || *c == '\0')
+		{
+			if (!current.empty())
+				items.push_back(current);
+			current.clear();
+			if (*c == '\0')
+				break;
+		}
+		else
+			current += *c;
+	}
+	return items;
+}
+
+// Counts the checks that failed, and says which
+static int CheckScratchArena()
+{
+	int failures = 0;
+	auto check = [&](bool ok, const char* what)
+	{
+		if (!ok)
+		{
+			fprintf(stderr, "scratch arena: %s\n", what);
+			failures++;
+		}
+	};
+
+	// Rewinding hands the same memory out again, within a chunk and back across chunks
+	{
+		ScratchArena arena;
+		arena.Allocate(100);
+		ScratchArena::Mark mark = arena.GetMark();
+		size_t used = arena.Used();
+		void* first = arena.Allocate(256);
+		arena.Rewind(mark);
+		check(arena.Used() == used, "Rewind() didn't restore Used()");
+		check(arena.Allocate(256) == first, "Rewind() didn't give the memory back");
+
+		arena.Rewind(mark);
+		arena.Allocate(ScratchArena::CHUNK_SIZE); // Doesn't fit in what's left, takes a second chunk
+		size_t capacity = arena.Capacity();
+		arena.Rewind(mark);
+		check(arena.Used() == used, "Rewind() across chunks didn't restore Used()");
+		check(arena.Allocate(256) == first, "Rewind() across chunks didn't give the memory back");
+		check(arena.Capacity() == capacity, "Rewind() freed or added chunks");
+		check(arena.HighWaterMark() >= used + ScratchArena::CHUNK_SIZE, "HighWaterMark() missed the second chunk");
+	}
+
+	// A step that took three chunks fits in one after Reset(), and the next such step allocates no chunk
+	{
+		ScratchArena arena;
+		const size_t block = ScratchArena::CHUNK_SIZE * 3 / 4;
+		for (int i = 0; i < 3; ++i)
+			arena.Allocate(block);
+		size_t capacity = arena.Capacity();
+		arena.Reset();
+		check(arena.Capacity() == capacity, "Reset() didn't keep the capacity");
+		check(arena.Used() == 0, "Reset() left bytes in use");
+
+		long long allocationsBefore = heapAllocations.load();
+		unsigned char* first = (unsigned char*)arena.Allocate(block);
+		bool contiguous = true;
+		for (int i = 1; i < 3; ++i)
+			contiguous &= (unsigned char*)arena.Allocate(block) == first + i * block;
+		check(contiguous, "Reset() didn't merge the chunks into one");
+		check(arena.Capacity() == capacity, "the step after Reset() took another chunk");
+		check(heapAllocations.load() == allocationsBefore, "the step after Reset() allocated from the heap");
+	}
+
+	// Growing moves the elements to blocks twice the size, they all come along
+	{
+		ScratchArena arena;
+		ScratchArray<int> values;
+		const int count = 100000;
+		for (int i = 0; i < count; ++i)
+			values.PushBack(arena, i * 3);
+		bool kept = values.Size() == (size_t)count;
+		for (int i = 0; kept && i < count; ++i)
+			kept = values[i] == i * 3;
+		check(kept, "ScratchArray lost elements while growing");
+
+		values.Resize(arena, count * 2);
+		kept = values.Size() == (size_t)count * 2;
+		for (int i = 0; kept && i < count; ++i)
+			kept = values[i] == i * 3;
+		check(kept, "ScratchArray::Resize() lost elements");
+
+		// After Reset() the array has to let go and start over in the new chunk
+		values.Release();
+		arena.Reset();
+		values.PushBack(arena, 7);
+		check(values.Size() == 1 && values[0] == 7, "ScratchArray didn't start over after Release()");
+	}
+
+	// Threads filling sub-arenas at once each keep their own memory, the parent's Reset() resets them all,
+	// and merged like the parent's chunks the next round needs no new chunk
+	{
+		ScratchArena arena;
+		const int threadCount = 4;
+		const size_t count = ScratchArena::CHUNK_SIZE / sizeof(int); // Over a chunk each, so they take several
+		arena.ReserveSubArenas(threadCount);
+		check(arena.SubArenaCount() == (size_t)threadCount, "ReserveSubArenas() made the wrong number");
+
+		size_t capacities[threadCount];
+		for (int round = 0; round < 2; ++round)
+		{
+			int* blocks[threadCount];
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; ++t)
+				threads.emplace_back([&, t]()
+				{
+					ScratchArena& mine = arena.SubArena(t);
+					blocks[t] = mine.Allocate<int>(count / 2);
+					int* rest = mine.Allocate<int>(count / 2 + 1);
+					for (size_t i = 0; i < count / 2; ++i)
+						blocks[t][i] = rest[i] = t * 1000003 + (int)i;
+				});
+			for (std::thread& thread : threads)
+				thread.join();
+
+			bool kept = true;
+			for (int t = 0; t < threadCount; ++t)
+				for (size_t i = 0; kept && i < count / 2; ++i)
+					kept = blocks[t][i] == t * 1000003 + (int)i;
+			check(kept, "threads wrote over each other's sub-arenas");
+			bool grew = false;
+			for (int t = 0; t < threadCount; ++t)
+				grew |= round == 1 && arena.SubArena(t).Capacity() != capacities[t];
+			check(!grew, "sub-arenas took another chunk after Reset()");
+
+			arena.Reset();
+			bool empty = true;
+			for (int t = 0; t < threadCount; ++t)
+			{
+				empty &= arena.SubArena(t).Used() == 0;
+				capacities[t] = arena.SubArena(t).Capacity();
+			}
+			check(empty, "Reset() didn't reset the sub-arenas");
+		}
+
+		arena.Release();
+		check(arena.SubArena(0).Capacity() == 0, "Release() didn't free the sub-arenas' chunks");
+	}
+
+	fprintf(stderr, "scratch arena: %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	ScratchArena::SetAllocator(CountedMalloc, free);
+
+	std::vector<std::string> sceneNames;
+	std::vector<int> sizes = { 1000, 10000, 100000 };
+	int steps = 100;
+	int warmup = 10;
+	const char* outPath = nullptr;
+	const char* baselinePath = nullptr;
+	double threshold = 0.10;
+	IntegratorType integrator = INTEGRATOR_SEMI_IMPLICIT_EULER;
+	bool reorder = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--accuracy") == 0)
+			return RunAccuracyBench();
+		else if (strcmp(argv[i], "--arena") == 0)
+			return CheckScratchArena() > 0 ? 1 : 0;
+		else if (strcmp(argv[i], "--integrator") == 0 && hasValue)
+		{
+			if (!PhysicsSimulation::FindIntegrator(argv[++i], &integrator))
+			{
+				fprintf(stderr, "unknown integrator %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--reorder") == 0)
+			reorder = true;
+		else if (strcmp(argv[i], "--scenes") == 0 && hasValue)
+			sceneNames = SplitList(argv[++i]);
+		else if (strcmp(argv[i], "--sizes") == 0 && hasValue)
+		{
+			sizes.clear();
+			for (const std::string& size : SplitList(argv[++i]))
+				sizes.push_back(atoi(size.c_str()));
+		}
+		else if (strcmp(argv[i], "--steps") == 0 && hasValue)
+			steps = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+			warmup = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--out") == 0 && hasValue)
+			outPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+			threshold = atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "unknown argument %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	int arenaFailures = CheckScratchArena();
+
+	std::vector<BenchResult> results;
+	for (int s = 0; s < STRESS_SCENE_COUNT; ++s)
+	{
+		const StressScene& scene = STRESS_SCENES[s];
+		if (!sceneNames.empty() && std::find(sceneNames.begin(), sceneNames.end(), scene.name) == sceneNames.end())
+			continue;
+
+		for (int size : sizes)
+		{
+			results.push_back(RunScenario(scene, size, steps, warmup, integrator, reorder));
+			const BenchResult& r = results.back();
+			fprintf(stderr, "%-16s %10.1f steps/s  p50 %8.3f ms  p99 %8.3f ms  %.2f allocs/step  scratch %lld KB\n", r.name.c_str(),
+				r.stepsPerSec, r.p50Ms, r.p99Ms, r.allocationsPerStep, r.scratchBytes / 1024);
+		}
+	}
+
+	// Stepping is meant to be done with the heap once warmed up
+	int allocating = 0;
+	for (const BenchResult& r : results)
+		if (r.allocationsPerStep > 0.0)
+		{
+			fprintf(stderr, "%-16s allocated %.2f times per step\n", r.name.c_str(), r.allocationsPerStep);
+			allocating++;
+		}
+
+	WriteJson(results, stdout);
+	if (outPath != nullptr)
+	{
+		FILE* out = fopen(outPath, "w");
+		if (out == nullptr)
+		{
+			fprintf(stderr, "can't write %s\n", outPath);
+			return 2;
+		}
+		WriteJson(results, out);
+		fclose(out);
+	}
+
+	if (baselinePath == nullptr)
+		return allocating + arenaFailures > 0 ? 1 : 0;
+
+	std::vector<BenchResult> baseline;
+	if (!ReadBaseline(baselinePath, baseline))
+	{
+		fprintf(stderr, "can't read baseline %s\n", baselinePath);
+		return 2;
+	}
+
+	int regressions = 0;
+	for (const BenchResult& r : results)
+	{
+		auto old = std::find_if(baseline.begin(), baseline.end(), [&](const BenchResult& b) { return b.name == r.name; });
+		if (old == baseline.end() || old->stepsPerSec <= 0.0)
+			continue;
+
+		double change = r.stepsPerSec / old->stepsPerSec - 1.0;
+		bool regressed = change < -threshold;
+		regressions += regressed;
+		fprintf(stderr, "%-16s %10.1f -> %10.1f steps/s (%+.1f%%)%s\n", r.name.c_str(), old->stepsPerSec, r.stepsPerSec,
+			change * 100.0, regressed ? "  REGRESSION" : "");
+	}
+	return regressions + allocating + arenaFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+/*
+Headless batch commands, shared by the game executable and physics-batch:
+  --sweep [targetX targetY]   launch angle/speed sweep against the scene
+  --worlds count [steps]      step many variations of the scene on the world scheduler
+  --trajectory file [step]    print a recording made with --record, at its last or the given step
+  --replay file               replay a session recorded with --record-input as fast as possible
+  --stream [steps] [dir]      fly across a generated world streamed in chunks, saved to dir or kept in memory
+*/
+
+#pragma once
+
+#include "launch_controls.h"
+#include "physics.h"
+
+bool IsBatchCommand(int argc, char** argv);
+
+// Runs the command in argv against scene and returns the process exit code
+int RunBatchCommand(int argc, char** argv, const PhysicsSimulation& scene, const LaunchControls& launch);
@@ -0,0 +1,15 @@
+/*
+DEFLATE compression of byte buffers with raylib's bundled sdefl/sinfl.
+The game calls CompressData()/DecompressData() from raylib, headless builds that don't link raylib
+define PHYSICS_BUNDLED_DEFLATE and compile the two single header libraries in directly.
+*/
+
+#pragma once
+
+#include <vector>
+
+// Replaces out with the compressed data, false if compression failed
+bool DeflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out);
+
+// Decompresses into out, which must already hold the expected size; false if the sizes don't match
+bool InflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out);
@@ -0,0 +1,103 @@
+/*
+Forces on the bodies besides gravity, registered in PhysicsSimulation::forceGenerators.
+
+Every substep PhysicsSimulation::AccumulateForces() sums what acts on each body into one acceleration:
+gravity first, then one pass over all bodies per generator, in the order they were registered. The
+type is picked once per pass, not per body, so each pass is a straight loop the compiler can vectorize.
+Bodies have no mass, a force is the acceleration it causes.
+
+A generator acts on the bodies whose PhysicsBody::forceGroups share a bit with its groups. Static
+bodies (no gravity and at rest, like pegs and half-spaces) stay in place whatever acts on them.
+*/
+
+#pragma once
+
+#include "raylib.h"
+#include "raymath.h"
+#include <cmath>
+#include <cstdint>
+
+typedef enum ForceGeneratorType
+{
+	FORCE_UNIFORM, // vector times the body's gravityScale, like gravity
+	FORCE_LINEAR_DRAG, // -strength * velocity, times the body's drag
+	FORCE_QUADRATIC_DRAG, // -strength * |velocity| * velocity, times the body's drag
+	FORCE_WIND, // Inside zone: strength * (vector - velocity), drags bodies along with air moving at vector
+	FORCE_ATTRACTOR, // Toward vector: strength / distance^2, no closer than radius. Negative strength repels
+	FORCE_SPRING, // Toward the anchor at vector: strength * (distance - radius), less damping * velocity
+	FORCE_GENERATOR_COUNT
+} ForceGeneratorType;
+
+struct ForceGenerator
+{
+	ForceGeneratorType type = FORCE_UNIFORM;
+	uint32_t groups = 0xFF; // All bodies by default, 0 switches the generator off. Bodies have 8 groups, wider to leave no padding
+	Vector2 vector = Vector2Zeros; // Acceleration, wind velocity, attractor center or spring anchor, by type
+	float strength = 0.0f;
+	float radius = 0.0f; // Attractors: where the pull stops growing. Springs: rest length
+	float damping = 0.0f; // Springs only
+	Rectangle zone = { 0.0f, 0.0f, 0.0f, 0.0f }; // Wind only
+};
+
+static_assert(sizeof(ForceGenerator) == 44, "Snapshots copy generators byte for byte, padding would tell equal worlds apart");
+
+// What generator g adds to the acceleration of a body at the given state. The batched passes and the
+// integrators sampling between two states both go through here, so they agree to the bit.
+// No branches and no std::min/max, GCC leaves loops with either unvectorized.
+template <ForceGeneratorType Type>
+inline Vector2 ForceAcceleration(const ForceGenerator& g, Vector2 position, Vector2 velocity, float gravityScale, float drag)
+{
+	if constexpr (Type == FORCE_UNIFORM)
+		return g.vector * gravityScale;
+
+	if constexpr (Type == FORCE_LINEAR_DRAG)
+		return velocity * (-g.strength * drag);
+
+	if constexpr (Type == FORCE_QUADRATIC_DRAG)
+		return velocity * (-g.strength * drag * Vector2Length(velocity));
+
+	if constexpr (Type == FORCE_WIND)
+	{
+		// & rather than &&, no branches in the passes
+		bool inside = (position.x >= g.zone.x) & (position.x < g.zone.x + g.zone.width) &
+			(position.y >= g.zone.y) & (position.y < g.zone.y + g.zone.height);
+		return (g.vector - velocity) * (inside ? g.strength : 0.0f);
+	}
+
+	if constexpr (Type == FORCE_ATTRACTOR)
+	{
+		// Never quite 0 apart, a body right on the center is pulled nowhere instead of by infinity
+		Vector2 offset = g.vector - position;
+		float distanceSqr = Vector2LengthSqr(offset);
+		float minimumSqr = g.radius * g.radius > 1e-12f ? g.radius * g.radius : 1e-12f; // Not std::max, see above
+		distanceSqr = distanceSqr > minimumSqr ? distanceSqr : minimumSqr;
+		return offset * (g.strength / (distanceSqr * sqrtf(distanceSqr))); // strength / d^2 along offset / d
+	}
+
+	if constexpr (Type == FORCE_SPRING)
+	{
+		// Along offset / distance, nowhere right on the anchor
+		Vector2 offset = g.vector - position;
+		float distanceSqr = Vector2LengthSqr(offset);
+		float distance = sqrtf(distanceSqr);
+		float pull = g.strength * (distance - g.radius) / sqrtf(distanceSqr > 1e-12f ? distanceSqr : 1e-12f);
+		return offset * pull - velocity * g.damping;
+	}
+
+	return Vector2Zeros;
+}
+
+// Same for a type only known at run time
+inline Vector2 ForceAcceleration(const ForceGenerator& g, Vector2 position, Vector2 velocity, float gravityScale, float drag)
+{
+	switch (g.type)
+	{
+	case FORCE_UNIFORM: return ForceAcceleration<FORCE_UNIFORM>(g, position, velocity, gravityScale, drag);
+	case FORCE_LINEAR_DRAG: return ForceAcceleration<FORCE_LINEAR_DRAG>(g, position, velocity, gravityScale, drag);
+	case FORCE_QUADRATIC_DRAG: return ForceAcceleration<FORCE_QUADRATIC_DRAG>(g, position, velocity, gravityScale, drag);
+	case FORCE_WIND: return ForceAcceleration<FORCE_WIND>(g, position, velocity, gravityScale, drag);
+	case FORCE_ATTRACTOR: return ForceAcceleration<FORCE_ATTRACTOR>(g, position, velocity, gravityScale, drag);
+	case FORCE_SPRING: return ForceAcceleration<FORCE_SPRING>(g, position, velocity, gravityScale, drag);
+	default: return Vector2Zeros;
+	}
+}
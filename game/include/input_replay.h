@@ -0,0 +1,111 @@
+/*
+Records what the player did, per simulation step, and plays it back into a fresh simulation.
+
+raylib's automation events capture raw device state each frame and need a window to play back,
+their loader parses text with sscanf and stops at MAX_AUTOMATION_EVENTS. This format stores the
+inputs that matter to the simulation instead: launcher keys and slider changes, each stamped with
+the step it happened before. Because the simulation only advances in fixed steps, applying the
+same inputs before the same steps reproduces the exact same state, with or without a window.
+
+File layout: InputReplayHeader, the simulation snapshot at the start, then InputEvent records up to
+the end of the file. Events are appended as they happen, so there's no limit on a session's length.
+*/
+
+#pragma once
+
+#include "launch_controls.h"
+#include "physics.h"
+#include <cstdio>
+
+typedef enum InputEventType
+{
+	INPUT_EVENT_KEY_PRESSED = 1, // key: one of LAUNCH_KEYS
+	INPUT_EVENT_LAUNCH_ANGLE, // value: the slider's new value
+	INPUT_EVENT_LAUNCH_SPEED,
+	INPUT_EVENT_LAUNCH_X,
+	INPUT_EVENT_END, // hash: HashBodies() when recording stopped
+} InputEventType;
+
+struct InputEvent
+{
+	uint64_t step; // Applied when sim.StepCount() reaches this, before the next step
+	uint32_t type;
+	int32_t key;
+	float value;
+	uint32_t reserved;
+	uint64_t hash;
+};
+
+struct InputReplayHeader
+{
+	char magic[4] = { 'P', 'I', 'N', 'P' };
+	uint32_t version = 1;
+	float timeStep = 0.0f;
+	LaunchControls launch;
+	uint32_t snapshotSize = 0;
+};
+
+// Fingerprint of every body's position and velocity, to check a replay against its recording
+uint64_t HashBodies(const PhysicsSimulation& sim);
+
+class InputRecorder
+{
+public:
+	InputRecorder() = default;
+	~InputRecorder();
+
+	InputRecorder(const InputRecorder&) = delete;
+	InputRecorder& operator=(const InputRecorder&) = delete;
+
+	// Saves the starting state, record from before the first step the session will take
+	bool Open(const char* path, const PhysicsSimulation& sim, const LaunchControls& launch, float timeStep);
+	bool IsOpen() const { return file != nullptr; }
+
+	void RecordKey(const PhysicsSimulation& sim, int key);
+
+	// Records whichever launcher values differ between before and after, for changes made by the sliders
+	void RecordChanges(const PhysicsSimulation& sim, const LaunchControls& before, const LaunchControls& after);
+
+	// Ends the recording with the hash of the final state
+	void Close(const PhysicsSimulation& sim);
+
+private:
+	FILE* file = nullptr;
+
+	void Write(const PhysicsSimulation& sim, InputEventType type, int key, float value);
+};
+
+class InputReplay
+{
+public:
+	InputReplay() = default;
+	~InputReplay() { Close(); }
+
+	InputReplay(const InputReplay&) = delete;
+	InputReplay& operator=(const InputReplay&) = delete;
+
+	// Restores the recorded starting state into sim and launch
+	bool Open(const char* path, PhysicsSimulation& sim, LaunchControls& launch);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+	float TimeStep() const { return header.timeStep; }
+
+	// Applies the events due before the next step, returns false once the recording is over.
+	// Drive it with: while (replay.Apply(sim, launch)) sim.Step(replay.TimeStep());
+	bool Apply(PhysicsSimulation& sim, LaunchControls& launch);
+
+	// Whether the recording ended cleanly with a hash, and whether sim matches it
+	bool HasEndHash() const { return hasEnd; }
+	bool Matches(const PhysicsSimulation& sim) const { return hasEnd && HashBodies(sim) == endHash; }
+
+private:
+	FILE* file = nullptr;
+	InputReplayHeader header;
+	InputEvent next{};
+	bool hasNext = false;
+	bool hasEnd = false;
+	uint64_t endHash = 0;
+
+	void ReadNext();
+};
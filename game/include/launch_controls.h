@@ -0,0 +1,31 @@
+/*
+The player's launcher and what its keys do, shared by the game loop and input replays so both
+turn the same inputs into exactly the same launches.
+*/
+
+#pragma once
+
+#include "physics.h"
+
+struct LaunchControls
+{
+	Vector2 position = { 600, 100 };
+	float angle = 300.0f; // degrees
+	float speed = 150.0f;
+	float radius = 20.0f;
+
+	Vector2 Velocity() const;
+
+	// Adds a circle leaving the launcher to the simulation
+	void Launch(PhysicsSimulation& sim) const;
+};
+
+// Keys the launcher reacts to: SPACE launches, U/I/O/P/J/K/L pick a preset angle
+extern const int LAUNCH_KEYS[];
+extern const int LAUNCH_KEY_COUNT;
+
+// Applies one pressed launcher key, false for keys the launcher ignores
+bool ApplyLaunchKey(LaunchControls& launch, PhysicsSimulation& sim, int key);
+
+// Just the angle presets, for a copy of the launcher that has no simulation to launch into
+bool ApplyLaunchPreset(LaunchControls& launch, int key);
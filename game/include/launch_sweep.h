@@ -0,0 +1,52 @@
+/*
+Headless batch solver that tries a grid of launch angles and speeds against a scene.
+Every launch runs in its own copy of the scene, the copies are spread over worker threads.
+*/
+
+#pragma once
+
+#include "physics.h"
+#include <cstdio>
+
+struct LaunchSweepSettings
+{
+	Vector2 launchPosition = { 600, 100 };
+	float launchRadius = 20.0f;
+
+	float minAngle = 0.0f; // degrees
+	float maxAngle = 360.0f;
+	int angleSteps = 72;
+
+	float minSpeed = 25.0f;
+	float maxSpeed = 200.0f;
+	int speedSteps = 36;
+
+	Vector2 target = { 600, 600 };
+	float targetRadius = 30.0f; // A launch hits if the projectile touches this circle
+
+	float maxTime = 10.0f; // Seconds simulated per launch
+	int threadCount = 0; // 0 = one per hardware thread
+};
+
+struct LaunchSweepResult
+{
+	LaunchSweepSettings settings;
+
+	// One entry per launch, index = speedIndex * angleSteps + angleIndex
+	std::vector<float> hitTime; // Seconds until the target was touched, -1 on a miss
+	std::vector<float> missDistance; // Closest the projectile got to the target surface, 0 on a hit
+
+	int best = -1; // Earliest hit, or the nearest miss if nothing hit
+	int hitCount = 0;
+	double seconds = 0.0; // Wall time of the sweep
+
+	float Angle(int launch) const;
+	float Speed(int launch) const;
+	bool Hit(int launch) const { return hitTime[launch] >= 0.0f; }
+};
+
+// scene is only read, it can keep being used while the sweep runs
+LaunchSweepResult RunLaunchSweep(const PhysicsSimulation& scene, const LaunchSweepSettings& settings);
+
+// Hit map (rows = speed, columns = angle) and the best parameters
+void PrintLaunchSweep(const LaunchSweepResult& result, FILE* out);
@@ -0,0 +1,522 @@
+/*
+Rigid body simulation used by the game. Only needs raymath and the raylib types,
+nothing in here opens a window or touches the GPU.
+*/
+
+#pragma once
+
+#include "raylib.h"
+#include "raymath.h"
+#include "force_generators.h"
+#include "scratch_arena.h"
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+//struct Circle
+//{
+//	Vector2 position = Vector2Zeros;
+//	float radius = 0.0f;
+//};
+
+enum ColliderType
+{
+	COLLIDER_TYPE_INVALID,
+	COLLIDER_TYPE_CIRCLE,
+	COLLIDER_TYPE_HALF_SPACE
+	// COLLIDER_BOX
+};
+
+// Union to hold different collider types in a single variable
+union Collider
+{
+	struct
+	{
+		float radius;
+	} circle;
+
+	struct
+	{
+		Vector2 normal; // Direction the half-space is facing
+		float distance; // Distance from 0,0
+	} halfSpace;
+};
+
+// Stable reference to a body, survives culling and reordering where an index into objects doesn't.
+// The low 24 bits pick a slot of the handle table, the high 8 bits tell reuses of that slot apart.
+typedef uint32_t BodyHandle;
+static const BodyHandle BODY_HANDLE_NONE = 0xFFFFFFFFu;
+
+// Everything about a body, as AddBody() takes it. The simulation keeps it split by how often each part is used:
+// objects holds what every step reads and writes, details what only drawing and the odd half-space test need.
+struct PhysicsBodyDef
+{
+	Vector2 position = Vector2Zeros;
+	Vector2 velocity = Vector2Zeros;
+	float drag = 1.0f; // Scales the drag force generators for this body, 0 = untouched by them
+	float gravityScale = 1.0f;
+	uint8_t forceGroups = 1; // See ForceGenerator::groups
+	Color color = MAGENTA;
+	ColliderType colliderType = COLLIDER_TYPE_INVALID;
+	Collider collider{};
+};
+
+// The part of a body every step touches, packed into 24 bytes so a cache line holds more than two bodies.
+// gravityScale is 8.8 fixed point, exact for the usual 0 and 1, and the integration rate is a power of two.
+// Memory per body in the simulation: 24 here + 12 timers + 20 details + 8 step start position + 8 handle slot
+// = 72 bytes, of which the integration and the collision passes stream the 24.
+struct PhysicsBody
+{
+	Vector2 position;
+	Vector2 velocity;
+	float radius; // Circles only
+	int16_t gravityScale; // 1/256 units, see GravityScale()
+	uint8_t colliderType : 2; // ColliderType
+	uint8_t collision : 1; // If the body collided this frame
+	uint8_t sleeping : 1; // Skipped by the integration until something bumps into it
+	uint8_t deferred : 1; // Sitting out this step, see PhysicsSimulation::lodEnabled
+	uint8_t lodLevel : 3; // Integrated every 1 << lodLevel steps, 0 = full rate
+	uint8_t forceGroups; // Force generators with a group in common act on the body. Fills what would be padding
+
+	PhysicsBody()
+		: position(Vector2Zeros), velocity(Vector2Zeros), radius(0.0f), gravityScale(256),
+		colliderType(COLLIDER_TYPE_INVALID), collision(0), sleeping(0), deferred(0), lodLevel(0), forceGroups(1)
+	{
+	}
+
+	float GravityScale() const { return gravityScale * (1.0f / 256.0f); }
+	void SetGravityScale(float scale) { gravityScale = (int16_t)lroundf(Clamp(scale, -128.0f, 127.99f) * 256.0f); }
+
+	// Neither pulled by gravity nor moving
+	bool IsStatic() const
+	{
+		return gravityScale == 0 && velocity.x == 0.0f && velocity.y == 0.0f;
+	}
+};
+
+static_assert(sizeof(PhysicsBody) == 24, "The hot part of a body is meant to stay at 24 bytes");
+
+// Per body bookkeeping of the sleep check and the level of detail, indices match objects
+struct PhysicsBodyTimers
+{
+	float restTime = 0.0f; // Seconds the body has barely moved
+	float lodDt = 0.0f; // Time sat out since the last integration, added to the next one
+	float lodHoldTime = 0.0f; // Seconds left at full rate after coming near a full-rate body
+};
+
+// What the step rarely or never looks at, indices match objects
+struct PhysicsBodyDetails
+{
+	Color color = MAGENTA;
+	float drag = 1.0f; // Read by the drag force generators only
+	Vector2 normal = Vector2Zeros; // Half-spaces: direction the half-space is facing
+	BodyHandle handle = BODY_HANDLE_NONE; // Given out by the simulation
+};
+
+// Result of a raycast against the simulation
+struct RaycastHit
+{
+	int body = -1; // Index into PhysicsSimulation::objects
+	Vector2 point = Vector2Zeros;
+	Vector2 normal = Vector2Zeros; // Surface normal at the hit point
+	float distance = 0.0f;
+};
+
+// Pair of bodies (indices into PhysicsSimulation::objects) that overlapped in the narrowphase
+struct Contact
+{
+	int a, b;
+};
+
+// Wall time of each phase of the last step, in milliseconds
+struct PhysicsStepTimings
+{
+	double integrateMs = 0.0;
+	double broadphaseMs = 0.0;
+	double narrowphaseMs = 0.0;
+	double resolveMs = 0.0;
+};
+
+// Counters for one step, cheap enough to fill every step
+struct PhysicsStepStats
+{
+	uint64_t step = 0;
+
+	int activeBodies = 0;
+	int sleepingBodies = 0;
+	int staticBodies = 0;
+	int reducedRateBodies = 0; // Integrated at less than every step
+
+	int candidatePairs = 0; // Pairs the broadphase handed to the narrowphase
+	int narrowphaseTests = 0; // Candidates actually tested, pairs of resting bodies are skipped
+	int narrowphaseHits = 0;
+	int contactsResolved = 0; // Contacts that still overlapped when their turn came
+	float broadphaseEfficiency = 0.0f; // narrowphaseHits / narrowphaseTests
+
+	float stepDt = 0.0f; // What Step() was given
+	float time = 0.0f; // Simulation time at the end of the step
+
+	int bodiesSpawned = 0; // Added to objects since the previous step
+	int bodiesCulled = 0; // Removed for leaving cullBounds
+	int bodiesReordered = 0; // Moved to another index by the Morton reordering
+	int scratchBytes = 0; // Taken from the scratch arena by the step, and by the grid from its own
+
+	int qualityTier = 0; // How many of the budget's degradations are active, 0 = full quality
+	float stepCostMs = 0.0f; // Smoothed wall time of Step(), measured while the budget is enabled
+};
+
+// Ways to make a step cheaper, applied in the order given by PhysicsBudget::order
+typedef enum BudgetDegradation
+{
+	BUDGET_DEGRADE_SOLVER, // A single substep and solver iteration
+	BUDGET_DEGRADE_FAR_BODIES, // Bodies outside focusBounds step at half the level of detail rate
+	BUDGET_DEGRADE_DEFERRED_WORK, // Sleep checks and culling only every deferredWorkInterval steps
+	BUDGET_DEGRADATION_COUNT
+} BudgetDegradation;
+
+// Keeps the step under budgetMs by trading quality for time.
+// While the smoothed step cost is above degradeAbove * budgetMs the next degradation in order is switched on,
+// once it has stayed below restoreBelow * budgetMs for settleSteps the last one is switched off again.
+// It goes by the wall clock, so a simulation with the budget enabled doesn't replay step for step.
+struct PhysicsBudget
+{
+	bool enabled = false;
+	float budgetMs = 1000.0f / 50.0f;
+	float degradeAbove = 0.9f;
+	float restoreBelow = 0.5f;
+	int settleSteps = 25; // Also the wait after every change, for the smoothed cost to catch up
+
+	BudgetDegradation order[BUDGET_DEGRADATION_COUNT] = {
+		BUDGET_DEGRADE_SOLVER, BUDGET_DEGRADE_FAR_BODIES, BUDGET_DEGRADE_DEFERRED_WORK };
+	int orderCount = BUDGET_DEGRADATION_COUNT; // Degradations past this are never used
+};
+
+// How UpdateObjectPositions() moves the bodies
+typedef enum IntegratorType
+{
+	INTEGRATOR_SEMI_IMPLICIT_EULER, // Velocity, then position with the new velocity. Arcs drift by g * dt * t / 2
+	INTEGRATOR_VELOCITY_VERLET, // Position from velocity and acceleration, velocity from the average acceleration
+	INTEGRATOR_POSITION_BASED, // Verlet prediction, contacts project the positions and the velocities follow them
+	INTEGRATOR_RK4, // Runge-Kutta 4 for bodies in free flight, semi-implicit Euler for bodies in contact
+	INTEGRATOR_COUNT
+} IntegratorType;
+
+// Step size picked by PhysicsSimulation::NextTimeStep(): as large as possible while no body moves more than
+// cfl times the smallest circle radius in one step, which also bounds how deep bodies can sink into each other
+struct AdaptiveTimestep
+{
+	bool enabled = false;
+	float minDt = 1.0f / 200.0f;
+	float maxDt = 1.0f / 20.0f;
+	float cfl = 0.5f;
+};
+
+// Uniform grid over the circle bodies, rebuilt every step.
+// Cells are hashed into a fixed table so the world doesn't need bounds.
+// The arrays live in an arena of the grid's own, reset by every rebuild: queries between steps still read
+// the last grid, so it can't go with the step's scratch.
+struct SpatialGrid
+{
+	struct Entry
+	{
+		int cellX, cellY; // Cell this entry was inserted into
+		int minCellX, minCellY; // First cell the body overlaps, used to report each body once
+		int body;
+	};
+
+	float cellSize = 64.0f;
+	float inverseCellSize = 1.0f / 64.0f;
+	uint32_t hashMask = 0;
+	ScratchArena storage;
+	ScratchArray<int> bucketStart; // Prefix sums, entries of bucket b are [bucketStart[b], bucketStart[b + 1])
+	ScratchArray<int> bucketFill;
+	ScratchArray<Entry> entries;
+	ScratchArray<int> halfSpaces; // Infinite, so kept out of the grid and tested directly
+
+	// Range of occupied cells, queries are clamped to it
+	int minCellX = 0, minCellY = 0, maxCellX = -1, maxCellY = -1;
+
+	SpatialGrid() = default;
+	SpatialGrid(const SpatialGrid& other) { *this = other; }
+	SpatialGrid& operator=(const SpatialGrid& other); // Copies the arrays into this grid's storage
+
+	void Clear(); // Empty, ready for the next build. The storage is kept.
+
+	uint32_t Hash(int x, int y) const
+	{
+		return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u) & hashMask;
+	}
+
+	int CellCoord(float v) const
+	{
+		return (int)std::floor(v * inverseCellSize);
+	}
+};
+
+class PhysicsSimulation
+{
+	float dt = 1.0f / TARGET_FPS; //seconds/frame
+	float time = 0;
+	uint64_t stepCount = 0;
+	SpatialGrid broadphase;
+	std::vector<PhysicsBodyTimers> timers; // Same index as objects
+	std::vector<Vector2> stepStartPositions; // Where each body began the step, for the sleep test
+	size_t lastBodyCount = 0; // objects.size() at the end of the previous step
+	int substep = 0; // Of the step in progress, only the first records stepStartPositions
+	int stepSubsteps = 1;
+
+	// Handle table: slot -> index into objects, -1 while free
+	struct HandleSlot
+	{
+		int index;
+		uint8_t generation;
+	};
+	std::vector<HandleSlot> handleSlots;
+	std::vector<uint32_t> freeHandleSlots;
+	size_t handledBodies = 0; // objects before this have their handle, later ones were added since
+
+	// Data that lives through one step, reset when the next one starts
+	ScratchArena scratch;
+
+	// Position-based integrator: where each body was predicted to be and 1 / the dt it moved by, 0 if it didn't move
+	ScratchArray<Vector2> predictedPositions;
+	ScratchArray<float> predictedInverseDt;
+
+	// Force generator passes, while there are generators: the bodies' state copied into plain arrays at the start
+	// of each substep, so every pass is a loop over floats the compiler vectorizes, and the sum of what acts on each
+	struct ForceArrays
+	{
+		ScratchArray<float> x, y, vx, vy, gravityScale, drag;
+		ScratchArray<uint32_t> groups; // 0 for static bodies
+		ScratchArray<float> ax, ay;
+
+		void Release();
+	} forces;
+
+	// Budget controller
+	int qualityTier = 0;
+	float stepCostMs = 0.0f;
+	int stepsSinceTierChange = 0;
+	int stepsUnderBudget = 0; // In a row below restoreBelow
+	uint64_t lastDeferredWorkStep = 0;
+	int reorderCursor = 0; // Where the next reorder window starts
+	bool reorderBackward = false; // Which way the reorder windows are sweeping
+
+	void UpdateBudget(float costMs);
+	int LodLevel(int i, bool farDegraded) const; // Level of detail body i gets, it steps every 1 << level steps
+	void PromoteNearFullRate(int a, int b);
+	void WakeOnContact(int a, int b);
+	void Integrate(int i, float bodyDt, bool ballistic);
+	void IntegrateEuler(int i, float h); // Through physics_kernels.h
+	Vector2 StartAcceleration(int i) const; // Of body i where the substep starts, from AccumulateForces() if it ran
+	void UpdatePositionBasedVelocities(); // After contacts were resolved, velocity picks up the corrections
+	template <typename Remove>
+	int CompactBodies(Remove remove); // Removes every body i remove(i) is true for, the rest keep their order
+	int SortBodies(int begin, int end); // Bodies in [begin, end) along the Z-order curve, without the grid rebuild
+	int SortNextWindow(); // Step()'s share of the reordering, the next reorderWindow bodies from reorderCursor
+	BodyHandle AllocateHandle(int index);
+	void RebuildHandles(); // From the handles in details, after objects was replaced wholesale
+	void RestoreHandles(const unsigned char* generations, uint32_t slotCount, const unsigned char* freeSlots, uint32_t freeCount);
+	void UpdateHandleIndices(int first, int last); // After bodies in [first, last) moved to other indices
+	template <typename Simulation, typename Field>
+	static void SnapshotScalars(Simulation& sim, Field&& field); // Simulation is const while saving
+	size_t SnapshotBodiesOffset() const;
+
+public:
+	static constexpr unsigned int TARGET_FPS = 50; //frames/second
+	Vector2 gravity = { 0, 9.81f }; // Gravity acceleration
+	std::vector<PhysicsBody> objects; // Add bodies with AddBody(), bodies pushed here alone get default details
+	std::vector<PhysicsBodyDetails> details; // Same index as objects
+	std::vector<ForceGenerator> forceGenerators; // Acting on the bodies besides gravity, see force_generators.h
+	float broadphaseCellSize = 0.0f; // 0 = twice the largest circle radius
+	ScratchArray<Contact> contacts; // Found by the last FindContacts(), gone when the next step starts
+
+	// Dynamic bodies that move slower than sleepSpeed (units/s) for sleepDelay seconds fall asleep
+	bool allowSleeping = true;
+	float sleepSpeed = 2.0f;
+	float sleepDelay = 0.5f;
+
+	// Dynamic circles that leave cullBounds are removed at the start of the next step
+	bool cullingEnabled = false;
+	Rectangle cullBounds = { -10000.0f, -10000.0f, 20000.0f, 20000.0f };
+
+	IntegratorType integrator = INTEGRATOR_SEMI_IMPLICIT_EULER;
+
+	// Quality of a step at full budget: Step() splits dt into substeps and resolves contacts solverIterations times per substep
+	int substeps = 1;
+	int solverIterations = 1;
+
+	// Level of detail: dynamic bodies beyond lodHalfRateDistance outside focusBounds are integrated every 2nd step,
+	// beyond lodQuarterRateDistance every 4th, each time with all the time they sat out.
+	// Bodies heading into range or coming near a full-rate body go back to full rate for at least lodHoldTime seconds.
+	bool lodEnabled = false;
+	Rectangle focusBounds = { -10000.0f, -10000.0f, 20000.0f, 20000.0f };
+	float lodHalfRateDistance = 100.0f;
+	float lodQuarterRateDistance = 400.0f;
+	float lodHoldTime = 0.5f;
+
+	int deferredWorkInterval = 10; // Used once the budget degrades, see BudgetDegradation
+
+	// Every reorderInterval steps a window of reorderWindow bodies is sorted along a Z-order curve of the broadphase
+	// cells, the next window half a window on, so bodies close in space end up close in memory and the collision passes
+	// walk it mostly in order. No step pays for more than one window, a full pass over objects is spread over
+	// objects.size() / (reorderWindow / 2) of them. Between two passes bodies only drift a little, so a window is
+	// usually a cheap insertion pass over a nearly sorted range. 0 sorts all of objects at once.
+	bool reorderEnabled = false;
+	int reorderInterval = 10;
+	int reorderWindow = 2048;
+
+	PhysicsBudget budget;
+	AdaptiveTimestep adaptiveTimestep;
+
+	PhysicsStepStats lastStats; // Filled by Step()
+
+	bool recordTimings = false; // Time the phases of Step() into lastTimings
+	PhysicsStepTimings lastTimings;
+
+	// Advances the world by stepDt seconds: integrate, then detect and resolve collisions
+	void Step(float stepDt);
+
+	void updateTime()
+	{
+		dt = 1.0f / TARGET_FPS;
+		time += dt;
+	}
+
+	float TimeStep() const { return dt; }
+
+	// dt for the next Step(): fixedDt, or picked by adaptiveTimestep when it's enabled.
+	// Depends only on the state, a replay that steps by it picks the same steps as the recording.
+	float NextTimeStep(float fixedDt) const;
+
+	// Where each body was when the last step began, indices match objects. For drawing between two steps.
+	const std::vector<Vector2>& StepStartPositions() const { return stepStartPositions; }
+	// Bytes, the most a step has needed so far, the grid's arena included
+	size_t ScratchHighWaterMark() const { return scratch.HighWaterMark() + broadphase.storage.HighWaterMark(); }
+	void ReleaseScratch(); // Frees the scratch memory until the next step, the contacts of the last step go with it
+	float SimulationTime() const { return time; }
+	uint64_t StepCount() const { return stepCount; }
+
+	// Budget state: how many degradations are active and whether a given one is
+	int QualityTier() const { return qualityTier; }
+	bool IsDegraded(BudgetDegradation degradation) const;
+	static const char* DegradationName(BudgetDegradation degradation);
+
+	static const char* IntegratorName(IntegratorType type);
+	static bool FindIntegrator(const char* name, IntegratorType* type); // By IntegratorName()
+
+	// Acceleration of body i at the given state, what the integrators sample between two states:
+	// gravity and the force generators, summed the same way AccumulateForces() does
+	Vector2 Acceleration(int i, Vector2 position, Vector2 velocity) const;
+
+	// Gravity and forceGenerators for every body where it is now, one pass per generator.
+	// UpdateObjectPositions() runs it at the start of each substep while there are generators.
+	void AccumulateForces();
+
+	void UpdateObjectPositions();
+
+	// Removes dynamic circles outside cullBounds, returns how many were removed
+	int CullBodies();
+
+	// Removes the bodies at the given indices, which must be ascending. Their handles stop working.
+	// The grid is rebuilt and the contacts dropped, so queries before the next step see only the survivors.
+	int RemoveBodies(const int* indices, int count);
+
+	// The body at index as AddBody() would take it back
+	PhysicsBodyDef BodyDef(int index) const;
+
+	// Moves the world by -offset: bodies, step start positions and the bounds, so a far away spot becomes the new 0,0.
+	// Nothing changes but where the origin is. Call it between steps.
+	void ShiftOrigin(Vector2 offset);
+
+	// Sorts objects along the Z-order curve now and rebuilds the grid, returns how many bodies changed index
+	int ReorderBodies();
+
+	// Handles. Bodies appended to objects get theirs, with their details, at the start of the next step or when
+	// Handle() asks, a handle stays valid until its body is culled. IndexOf() gives -1 for a body that is gone.
+	BodyHandle Handle(int index);
+	BodyHandle AddBody(const PhysicsBodyDef& def);
+	int IndexOf(BodyHandle handle) const;
+	PhysicsBody* Find(BodyHandle handle);
+	void SyncHandles(); // Gives bodies appended since the last call their handle, details and timers
+
+	// Puts resting bodies to sleep and counts bodies by state into lastStats, elapsed = seconds since the last check
+	void UpdateSleeping(float elapsed);
+
+	void WakeAll();
+
+	// Snapshots: the state as one flat buffer, a header of scalars followed by the body arrays copied with memcpy.
+	// Saving reuses the capacity of buffer and restoring that of objects, rolling back over and over doesn't allocate.
+	// The grid and contacts are derived and left out, queries come up empty until the next Step() or UpdateBroadphase().
+	size_t SnapshotSize() const;
+	void SaveSnapshot(std::vector<unsigned char>& buffer) const;
+	size_t SaveSnapshot(void* buffer, size_t capacity) const; // Returns the bytes written, 0 if it doesn't fit
+	bool RestoreSnapshot(const void* buffer, size_t size); // False if the buffer isn't a snapshot of this version
+
+	// Rebuilds the spatial grid from the current body positions.
+	// Queries see the world as of the last rebuild, CheckCollision() keeps it current,
+	// call this yourself after adding or moving bodies outside of a step.
+	void UpdateBroadphase();
+
+	// Calls visit(bodyIndex) once for every circle whose grid cells overlap the box
+	template <typename Visitor>
+	void ForEachCandidate(Vector2 boxMin, Vector2 boxMax, Visitor&& visit) const
+	{
+		const SpatialGrid& grid = broadphase;
+		if (grid.entries.Empty())
+			return;
+
+		int x0 = std::max(grid.CellCoord(boxMin.x), grid.minCellX);
+		int y0 = std::max(grid.CellCoord(boxMin.y), grid.minCellY);
+		int x1 = std::min(grid.CellCoord(boxMax.x), grid.maxCellX);
+		int y1 = std::min(grid.CellCoord(boxMax.y), grid.maxCellY);
+
+		for (int y = y0; y <= y1; ++y)
+			for (int x = x0; x <= x1; ++x)
+			{
+				uint32_t bucket = grid.Hash(x, y);
+				for (int e = grid.bucketStart[bucket]; e < grid.bucketStart[bucket + 1]; ++e)
+				{
+					const SpatialGrid::Entry& entry = grid.entries[e];
+					if (entry.cellX != x || entry.cellY != y)
+						continue; // Hash collision with another cell
+
+					// Only report from the first cell shared by the body and the box
+					if (std::max(entry.minCellX, x0) != x || std::max(entry.minCellY, y0) != y)
+						continue;
+
+					visit(entry.body);
+				}
+			}
+	}
+
+	// Spatial queries: write the indices of matching bodies into results and return how many were written.
+	// Half-spaces count as the solid region behind their normal.
+	int QueryPoint(Vector2 point, int* results, int maxResults) const;
+	int QueryAABB(Rectangle box, int* results, int maxResults) const;
+	int QueryCircle(Vector2 center, float radius, int* results, int maxResults) const;
+
+	// Finds the closest body along the ray, walking the grid cell by cell (Amanatides & Woo)
+	bool Raycast(Vector2 origin, Vector2 direction, float maxDistance, RaycastHit* hit) const;
+
+	// Broadphase, narrowphase and resolution in one go
+	void CheckCollision();
+
+	// Narrowphase: tests the broadphase candidates and fills contacts, flags the bodies that collide
+	void FindContacts();
+
+	// Pushes the bodies of every contact apart, iterations times, returns how many pairs overlapped on the first pass
+	int ResolveContacts(int iterations = 1);
+
+	// Narrowphase for bodies a and b, flags them if they collide
+	bool Overlaps(int a, int b);
+
+	// Narrowphase and positional correction for one pair, returns true if they collided
+	bool ResolvePair(int a, int b);
+
+	// Pair tests, computed by physics_kernels.h
+	static bool CircleCircle(Vector2 pos1, float rad1, Vector2 pos2, float rad2, Vector2* mtv = nullptr);
+	static bool CircleHalfSpace(Vector2 circlePos, float rad, Vector2 posHalfSpace, Vector2 normal, Vector2* mtv = nullptr);
+};
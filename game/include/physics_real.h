@@ -0,0 +1,164 @@
+/*
+Scalar types the kernels in physics_kernels.h are written for:
+
+	float     same as raylib, what the simulation runs
+	double    twice the bits, half the SIMD width
+	Fixed64   32.32 fixed point in integer arithmetic, the same bits on every compiler and CPU
+
+The simulation keeps its bodies in float and steps in float, physics-microbench runs the kernels in
+all three side by side to show what each type costs.
+*/
+
+#pragma once
+
+#include "raylib.h"
+#include <cmath>
+#include <cstdint>
+
+// Signed 32.32 fixed point, about 2e9 units of range at 2e-10 resolution. Products have to fit that range
+// too, so a square overflows past about 46000 units (the square root of 2^31): compare lengths before
+// squaring them, like CircleCircle() does. Multiplication rounds toward negative infinity and division
+// toward zero, like the 128-bit integer arithmetic they stand for, with or without a compiler that has it.
+struct Fixed64
+{
+	int64_t raw = 0;
+
+	static constexpr int FRACTION_BITS = 32;
+
+	Fixed64() = default;
+	explicit Fixed64(double value) : raw((int64_t)std::llround(value * 4294967296.0)) {}
+
+	static Fixed64 FromRaw(int64_t raw)
+	{
+		Fixed64 f;
+		f.raw = raw;
+		return f;
+	}
+
+	explicit operator float() const { return (float)(raw * (1.0 / 4294967296.0)); }
+	explicit operator double() const { return raw * (1.0 / 4294967296.0); }
+
+	Fixed64 operator-() const { return FromRaw(-raw); }
+	Fixed64 operator+(Fixed64 b) const { return FromRaw(raw + b.raw); }
+	Fixed64 operator-(Fixed64 b) const { return FromRaw(raw - b.raw); }
+	Fixed64 operator*(Fixed64 b) const { return FromRaw(MulShift(raw, b.raw)); }
+	Fixed64 operator/(Fixed64 b) const { return FromRaw(ShiftDiv(raw, b.raw)); }
+	Fixed64& operator+=(Fixed64 b) { raw += b.raw; return *this; }
+	Fixed64& operator-=(Fixed64 b) { raw -= b.raw; return *this; }
+	Fixed64& operator*=(Fixed64 b) { return *this = *this * b; }
+
+	bool operator==(Fixed64 b) const { return raw == b.raw; }
+	bool operator!=(Fixed64 b) const { return raw != b.raw; }
+	bool operator<(Fixed64 b) const { return raw < b.raw; }
+	bool operator<=(Fixed64 b) const { return raw <= b.raw; }
+	bool operator>(Fixed64 b) const { return raw > b.raw; }
+	bool operator>=(Fixed64 b) const { return raw >= b.raw; }
+
+	// Full 128-bit product of two unsigned 64-bit values
+	static void MulWide(uint64_t a, uint64_t b, uint64_t& hi, uint64_t& lo)
+	{
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 product = (unsigned __int128)a * b;
+		hi = (uint64_t)(product >> 64);
+		lo = (uint64_t)product;
+#else
+		// In 32-bit halves
+		uint64_t a0 = a & 0xFFFFFFFFu, a1 = a >> 32;
+		uint64_t b0 = b & 0xFFFFFFFFu, b1 = b >> 32;
+		uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		uint64_t middle = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu);
+		lo = middle << 32 | (p00 & 0xFFFFFFFFu);
+		hi = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+#endif
+	}
+
+	// a * b >> 32, from the full 128-bit product
+	static int64_t MulShift(int64_t a, int64_t b)
+	{
+		// The unsigned product, corrected for the signs
+		uint64_t hi, lo;
+		MulWide((uint64_t)a, (uint64_t)b, hi, lo);
+		if (a < 0)
+			hi -= (uint64_t)b;
+		if (b < 0)
+			hi -= (uint64_t)a;
+		return (int64_t)(hi << 32 | lo >> 32);
+	}
+
+	// (a << 32) / b, 0 for b = 0
+	static int64_t ShiftDiv(int64_t a, int64_t b)
+	{
+		if (b == 0)
+			return 0;
+#if defined(__SIZEOF_INT128__)
+		return (int64_t)(((__int128)a << FRACTION_BITS) / b);
+#else
+		// Long division of the 96-bit |a| << 32 by |b|, truncated toward zero like the integer division above
+		uint64_t ua = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+		uint64_t ub = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+		uint64_t hi = ua >> 32, lo = ua << 32;
+		uint64_t quotient = 0, remainder = 0;
+		for (int bit = 127; bit >= 0; --bit)
+		{
+			uint64_t next = bit >= 64 ? hi >> (bit - 64) & 1 : lo >> bit & 1;
+			bool carry = remainder >> 63 != 0;
+			remainder = remainder << 1 | next;
+			quotient <<= 1;
+			if (carry || remainder >= ub)
+			{
+				remainder -= ub;
+				quotient |= 1;
+			}
+		}
+		return (a < 0) != (b < 0) ? -(int64_t)quotient : (int64_t)quotient;
+#endif
+	}
+};
+
+// Square roots that round the same way everywhere: IEEE for the floating point types, exactly floored for Fixed64
+inline float RealSqrt(float v) { return sqrtf(v); }
+inline double RealSqrt(double v) { return sqrt(v); }
+
+inline Fixed64 RealSqrt(Fixed64 v)
+{
+	if (v.raw <= 0)
+		return Fixed64();
+
+	// sqrt(raw / 2^32) * 2^32 = floor(sqrt(raw << 32)). The double square root lands within one of it,
+	// the integer comparisons below settle the last step exactly, so the bits don't depend on the FPU.
+	uint64_t hi = (uint64_t)v.raw >> 32, lo = (uint64_t)v.raw << 32;
+	uint64_t root = (uint64_t)sqrt((double)v.raw * 4294967296.0);
+	auto above = [&](uint64_t r)
+	{
+		uint64_t squareHi, squareLo;
+		Fixed64::MulWide(r, r, squareHi, squareLo);
+		return squareHi > hi || (squareHi == hi && squareLo > lo);
+	};
+	while (above(root))
+		root--;
+	while (!above(root + 1))
+		root++;
+	return Fixed64::FromRaw((int64_t)root);
+}
+
+// 2D vector of any of the scalar types, with the operators raymath gives Vector2
+template <typename T>
+struct RealVector2
+{
+	T x, y;
+
+	static RealVector2 From(Vector2 v) { return { T(v.x), T(v.y) }; }
+	Vector2 ToVector2() const { return { (float)x, (float)y }; }
+
+	RealVector2 operator+(RealVector2 b) const { return { x + b.x, y + b.y }; }
+	RealVector2 operator-(RealVector2 b) const { return { x - b.x, y - b.y }; }
+	RealVector2 operator*(T s) const { return { x * s, y * s }; }
+	RealVector2& operator+=(RealVector2 b) { x += b.x; y += b.y; return *this; }
+
+	T Dot(RealVector2 b) const { return x * b.x + y * b.y; } // Fixed64: wraps past the range, see above
+};
+
+template <typename T> inline const char* RealName();
+template <> inline const char* RealName<float>() { return "float"; }
+template <> inline const char* RealName<double>() { return "double"; }
+template <> inline const char* RealName<Fixed64>() { return "fixed"; }
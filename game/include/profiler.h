@@ -0,0 +1,93 @@
+/*
+Scoped zone timer for finding where the frame goes.
+
+	PROFILE_ZONE("broadphase"); // Times the rest of the enclosing scope
+
+Zones are timed with the monotonic clock and summed into a buffer owned by the calling thread,
+so zones on different threads never contend. While the profiler is disabled a zone costs a single
+relaxed load, building with PHYSICS_PROFILER=0 removes them entirely.
+
+Once per frame the main thread calls Profiler::EndFrame(), which turns the per-thread sums into
+rolling averages and records the frame time. A capture records every zone as an event and writes
+it as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#ifndef PHYSICS_PROFILER
+	#define PHYSICS_PROFILER 1
+#endif
+
+struct ProfileZoneStats
+{
+	const char* name = nullptr;
+	double lastMs = 0.0; // Time spent in the zone during the last frame, summed over threads
+	double averageMs = 0.0; // Over the last Profiler::HISTORY frames
+};
+
+class Profiler
+{
+public:
+	static constexpr int MAX_ZONES = 64;
+	static constexpr int HISTORY = 120; // Frames kept for the averages and the frame time graph
+
+	static std::atomic<bool> enabled;
+
+	static void SetEnabled(bool on);
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Returns the id of the zone with this name, registering it on first use
+	static int RegisterZone(const char* name);
+
+	// Call once per frame on the main thread
+	static void EndFrame();
+
+	static int ZoneCount();
+	static ProfileZoneStats GetZone(int id);
+
+	// Frame times in ms, oldest first, HISTORY entries
+	static void GetFrameHistory(float* frameMs);
+	static double AverageFrameMs();
+
+	// Records every zone until EndCapture(), which writes the trace and returns false if the file failed
+	static void BeginCapture();
+	static bool EndCapture(const char* path);
+	static bool IsCapturing();
+
+	// Gives the calling thread its buffers now, several MB, instead of at its first zone in the middle of a frame.
+	// Threads that don't call it are registered by their first zone. A thread's buffers are freed when it exits.
+	static void RegisterThread();
+	static void UnregisterThread(); // Frees them early, zone time since the last EndFrame() is dropped
+
+	static uint64_t Now(); // Nanoseconds
+	static void Record(int zone, uint64_t start, uint64_t end);
+};
+
+class ProfileZone
+{
+	int zone;
+	uint64_t start;
+
+public:
+	explicit ProfileZone(int zone) : zone(zone), start(Profiler::IsEnabled() ? Profiler::Now() : 0) {}
+
+	~ProfileZone()
+	{
+		if (start != 0)
+			Profiler::Record(zone, start, Profiler::Now());
+	}
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PHYSICS_PROFILER
+	#define PROFILE_ZONE(name) \
+		static const int PROFILE_CONCAT(profileZoneId, __LINE__) = Profiler::RegisterZone(name); \
+		ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(PROFILE_CONCAT(profileZoneId, __LINE__))
+#else
+	#define PROFILE_ZONE(name) ((void)0)
+#endif
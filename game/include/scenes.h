@@ -0,0 +1,26 @@
+/*
+Scene setups shared by the game and the headless tools.
+*/
+
+#pragma once
+
+#include "physics.h"
+
+// A free falling circle above two half-spaces that form a V
+void BuildFunnelScene(PhysicsSimulation& sim);
+
+// Stress scenes for benchmarking, each filled with count circles
+void BuildFunnelFillScene(PhysicsSimulation& sim, int count); // The funnel above with circles stacked into it
+void BuildRainScene(PhysicsSimulation& sim, int count); // Projectiles falling on a floor from all heights
+void BuildPyramidScene(PhysicsSimulation& sim, int count); // Tightly packed pyramid resting on a floor
+void BuildSwarmScene(PhysicsSimulation& sim, int count); // Sparse, fast and weightless circles in a large box
+void BuildMixedRadiiScene(PhysicsSimulation& sim, int count); // Circles from tiny to large dropped into a box
+
+struct StressScene
+{
+	const char* name;
+	void (*build)(PhysicsSimulation& sim, int count);
+};
+
+extern const StressScene STRESS_SCENES[];
+extern const int STRESS_SCENE_COUNT;
@@ -0,0 +1,164 @@
+/*
+Bump allocator for data that only lives through one physics step.
+
+	scratch.Reset(); // Start of the step, everything handed out before is gone
+	int* order = scratch.Allocate<int>(count);
+
+Allocating moves a pointer, nothing is freed one by one. Memory comes in chunks of at least
+CHUNK_SIZE bytes, and when a step needed more than one chunk Reset() replaces them with a single
+chunk of their combined size, so after a few steps everything fits in one chunk and stepping
+allocates nothing from the heap. Only for trivially copyable types, nothing is destroyed.
+
+A copy starts out empty, what the original handed out stays the original's.
+
+Work spread over threads takes one sub-arena per thread, chained to the step's arena:
+
+	scratch.ReserveSubArenas(threadCount); // Before the threads start
+	int* mine = scratch.SubArena(thread).Allocate<int>(count); // Each thread only in its own
+
+They have chunks of their own, so the threads never share a pointer to bump, and the parent's Reset()
+and Release() take them along.
+
+Chunks come from malloc() unless SetAllocator() routed them elsewhere, the game counts them
+with raylib's memory tracker that way.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class ScratchArena
+{
+public:
+	typedef void* (*AllocateFunction)(size_t bytes);
+	typedef void (*FreeFunction)(void* memory);
+
+private:
+	struct Chunk
+	{
+		unsigned char* memory;
+		size_t size;
+		FreeFunction release; // Whatever allocated it, SetAllocator() can change in between
+	};
+
+	std::vector<Chunk> chunks;
+	size_t chunk = 0; // Being allocated from
+	size_t offset = 0; // Into chunks[chunk]
+	size_t usedBefore = 0; // By the chunks before chunks[chunk]
+	size_t highWaterMark = 0;
+	std::vector<std::unique_ptr<ScratchArena>> subArenas; // Pointers, so growing never moves one a thread is using
+
+	static AllocateFunction allocate;
+	static FreeFunction release;
+
+	void AddChunk(size_t size);
+
+public:
+	static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+	ScratchArena() = default;
+	ScratchArena(const ScratchArena&) {}
+	ScratchArena& operator=(const ScratchArena&) { return *this; }
+	~ScratchArena() { Release(); }
+
+	// Where every arena gets its chunks from now on, set it before any arena is in use on another thread
+	static void SetAllocator(AllocateFunction allocateChunk, FreeFunction freeChunk);
+
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	// count uninitialized Ts
+	template <typename T>
+	T* Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Nothing in the arena is destroyed");
+		return (T*)Allocate(count * sizeof(T), alignof(T));
+	}
+
+	void Reset(); // Sub-arenas too
+	void Release(); // Frees the chunks too, the next allocation starts over. Sub-arenas too, they stay usable.
+
+	// Makes sure there are at least count sub-arenas. Not while any of them is in use on another thread.
+	void ReserveSubArenas(size_t count);
+	ScratchArena& SubArena(size_t index) { return *subArenas[index]; }
+	size_t SubArenaCount() const { return subArenas.size(); }
+
+	// Restores the arena to how it was at the mark, for scratch used outside a step
+	struct Mark
+	{
+		size_t chunk, offset, usedBefore;
+	};
+	Mark GetMark() const { return { chunk, offset, usedBefore }; }
+	void Rewind(const Mark& mark);
+
+	size_t Used() const { return usedBefore + offset; }
+	size_t HighWaterMark() const { return highWaterMark; } // Most bytes in use at once since the arena was made
+	size_t Capacity() const;
+};
+
+// Growable array in a ScratchArena. Growing takes a new block twice the size, the old one stays behind until
+// the arena is reset. A copy starts out empty like the arena does.
+template <typename T>
+class ScratchArray
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Elements are moved with memcpy");
+
+	ScratchArena* arena = nullptr;
+	T* items = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+
+public:
+	ScratchArray() = default;
+	ScratchArray(const ScratchArray&) {}
+	ScratchArray& operator=(const ScratchArray&) { Release(); return *this; }
+
+	// Forgets the storage without touching the arena, before the arena is reset
+	void Release()
+	{
+		arena = nullptr;
+		items = nullptr;
+		count = capacity = 0;
+	}
+
+	void Reserve(ScratchArena& from, size_t n)
+	{
+		if (arena == &from && n <= capacity)
+			return;
+		T* grown = from.Allocate<T>(n);
+		if (count > 0)
+			memcpy(grown, items, count * sizeof(T));
+		arena = &from;
+		items = grown;
+		capacity = n;
+	}
+
+	void PushBack(ScratchArena& from, const T& value)
+	{
+		if (arena != &from || count == capacity)
+			Reserve(from, capacity < 64 ? 64 : capacity * 2);
+		items[count++] = value;
+	}
+
+	// Sets the size, new elements are uninitialized
+	void Resize(ScratchArena& from, size_t n)
+	{
+		Reserve(from, n);
+		count = n;
+	}
+
+	void Clear() { count = 0; }
+
+	size_t Size() const { return count; }
+	bool Empty() const { return count == 0; }
+	T* Data() { return items; }
+	T& operator[](size_t i) { return items[i]; }
+	const T& operator[](size_t i) const { return items[i]; }
+	T* begin() { return items; }
+	T* end() { return items + count; }
+	const T* begin() const { return items; }
+	const T* end() const { return items + count; }
+};
@@ -0,0 +1,153 @@
+/*
+Runs the simulation on its own thread in step with the clock, so a slow step no longer drops
+rendered frames and waiting for vsync no longer holds up physics. Steps are fixed, or sized by the
+simulation when its adaptive timestep is enabled. While every body is asleep or static the
+thread stops stepping and waits for the next command.
+
+The render thread never touches the simulation while the thread runs. It sends input through a
+lock-free SPSC queue and draws from RenderSnapshot, the render-relevant copy of the world the
+simulation thread publishes through a triple buffer after every step. A snapshot holds the
+state before and after its step along with when the later one is due, so the render thread can
+draw anywhere between the two whatever the step size.
+*/
+
+#pragma once
+
+#include "input_replay.h"
+#include "launch_controls.h"
+#include "physics.h"
+#include "spsc_queue.h"
+#include "stats_log.h"
+#include "trajectory_preview.h"
+#include "trajectory_recorder.h"
+#include "triple_buffer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct RenderBody
+{
+	Vector2 position;
+	Vector2 previousPosition; // Before the step
+	Vector2 normal; // Half-spaces only
+	float radius; // Circles only
+	Color color;
+	ColliderType colliderType;
+	bool collision;
+};
+
+struct RenderSnapshot
+{
+	uint64_t step = 0;
+	std::vector<RenderBody> bodies;
+	PhysicsStepStats stats;
+
+	// The step took the world from previousPosition to position, the latter is shown at due
+	std::chrono::steady_clock::time_point due;
+	float stepDt = 0.0f;
+	BudgetDegradation degradations[BUDGET_DEGRADATION_COUNT] = {}; // The first stats.qualityTier are active
+
+	LaunchControls launch; // As the simulation applied it, differs from the render thread's only during a replay
+	bool replaying = false;
+
+	bool idle = false; // Nothing moves, the thread waits for a command before it steps again
+	uint64_t commandsApplied = 0; // Commands taken off the queue before this snapshot
+
+	std::vector<Vector2> previewPoints;
+	bool previewHit = false;
+
+	std::vector<int> hovered; // Bodies under the pointer, indices into bodies
+
+	// 0 = previousPosition, 1 = position
+	float Alpha(std::chrono::steady_clock::time_point now) const
+	{
+		if (stepDt <= 0.0f)
+			return 1.0f;
+		float behind = std::chrono::duration<float>(due - now).count();
+		return std::min(std::max(1.0f - behind / stepDt, 0.0f), 1.0f);
+	}
+
+	Vector2 Position(const RenderBody& body, float alpha) const
+	{
+		return Vector2Lerp(body.previousPosition, body.position, alpha);
+	}
+};
+
+typedef enum SimCommandType
+{
+	SIM_COMMAND_KEY, // key: one of LAUNCH_KEYS
+	SIM_COMMAND_LAUNCH_ANGLE, // value: new slider value
+	SIM_COMMAND_LAUNCH_SPEED,
+	SIM_COMMAND_LAUNCH_X,
+	SIM_COMMAND_POINTER, // point: where the mouse is, for the hover query
+} SimCommandType;
+
+struct SimCommand
+{
+	SimCommandType type = SIM_COMMAND_KEY;
+	int key = 0;
+	float value = 0.0f;
+	Vector2 point = Vector2Zeros;
+};
+
+class SimulationThread
+{
+public:
+	// Optional sinks, fed from the simulation thread. Set them before Start() and leave them alone until Stop().
+	StatsLog* statsLog = nullptr;
+	TrajectoryRecorder* trajectoryRecorder = nullptr;
+	InputRecorder* inputRecorder = nullptr;
+	InputReplay* replay = nullptr; // Drives the launcher instead of the commands until it runs out
+
+	// sim and launch belong to the thread from Start() to Stop()
+	SimulationThread(PhysicsSimulation& sim, LaunchControls& launch) : sim(sim), launch(launch) {}
+	~SimulationThread() { Stop(); }
+
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	void Start(float stepsPerSecond = (float)PhysicsSimulation::TARGET_FPS);
+	void Stop();
+
+	// Render thread side. Send() returns false if the queue is full and the command was dropped.
+	bool Send(const SimCommand& command);
+	const RenderSnapshot& Latest()
+	{
+		snapshots.Acquire();
+		return snapshots.Front();
+	}
+
+	// True when frame shows an idle world and has seen every command sent, nothing will change until the next one.
+	// The render thread can then block on input instead of redrawing the same picture.
+	bool IsIdle(const RenderSnapshot& frame) const { return frame.idle && frame.commandsApplied == commandsSent; }
+
+private:
+	PhysicsSimulation& sim;
+	LaunchControls& launch;
+	TrajectoryPreview preview;
+	Vector2 pointer = { -1e9f, -1e9f };
+
+	SpscQueue<SimCommand, 256> commands;
+	TripleBuffer<RenderSnapshot> snapshots;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	// The thread sleeps on idleWake while the world is idle, Send() and Stop() wake it
+	std::mutex idleMutex;
+	std::condition_variable idleWake;
+	uint64_t commandsSent = 0; // Render thread only
+	uint64_t commandsApplied = 0; // Simulation thread only
+	bool idle = false; // Of the last published snapshot
+	float stepDt = 1.0f / PhysicsSimulation::TARGET_FPS; // When the simulation doesn't pick its own
+	std::chrono::steady_clock::time_point due; // Of the state being published
+	float lastDt = 0.0f;
+
+	void Run();
+	void WaitWhileIdle();
+	void ApplyCommands();
+	void Publish();
+};
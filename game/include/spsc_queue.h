@@ -0,0 +1,52 @@
+/*
+Lock-free queue from one producer thread to one consumer thread, over a fixed ring of Capacity slots.
+Push() fails instead of waiting when the ring is full, Pop() fails when it's empty.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+	static constexpr size_t MASK = Capacity - 1;
+
+	T slots[Capacity];
+
+	// Free-running counters, kept on separate cache lines so the two sides don't share one
+	alignas(64) std::atomic<size_t> head{ 0 }; // Next slot to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 }; // Next slot to push, written by the producer
+
+public:
+	// Producer side
+	bool Push(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		slots[t & MASK] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side
+	bool Pop(T& value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+
+		value = slots[h & MASK];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const
+	{
+		return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+	}
+};
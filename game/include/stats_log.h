@@ -0,0 +1,51 @@
+/*
+Streams PhysicsStepStats to a file, one record per step.
+CSV is easy to load in a spreadsheet, the binary format is a small header followed by fixed-size records.
+*/
+
+#pragma once
+
+#include "physics.h"
+#include <cstdio>
+
+typedef enum StatsLogFormat
+{
+	STATS_LOG_FORMAT_CSV,
+	STATS_LOG_FORMAT_BINARY,
+} StatsLogFormat;
+
+// Binary log layout: this header, then records up to the end of the file. A record is the fields of
+// PhysicsStepStats in declaration order, packed without padding: step as uint64, the rest 4 bytes each.
+static const uint32_t STATS_LOG_RECORD_SIZE = 8 + 17 * 4;
+
+struct StatsLogHeader
+{
+	char magic[4] = { 'P', 'S', 'T', 'S' };
+	uint32_t version = 2;
+	uint32_t recordSize = STATS_LOG_RECORD_SIZE;
+	float timeStep = 0.0f; // Nominal, every record has its own stepDt
+};
+
+class StatsLog
+{
+public:
+	StatsLog() = default;
+	~StatsLog() { Close(); }
+
+	StatsLog(const StatsLog&) = delete;
+	StatsLog& operator=(const StatsLog&) = delete;
+
+	// Paths ending in .csv default to CSV, anything else to binary
+	bool Open(const char* path, float timeStep);
+	bool Open(const char* path, float timeStep, StatsLogFormat format);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+	void Write(const PhysicsStepStats& stats);
+	uint64_t RecordCount() const { return recordCount; }
+
+private:
+	FILE* file = nullptr;
+	StatsLogFormat format = STATS_LOG_FORMAT_CSV;
+	uint64_t recordCount = 0;
+};
@@ -0,0 +1,172 @@
+/*
+Predicted flight of the next launch, drawn by the game as a guide.
+*/
+
+#pragma once
+
+#include "physics.h"
+#include <vector>
+
+// Ballistic arc p(t) = origin + velocity * t + gravity * t^2 / 2 of a launched circle.
+// Hits against half-spaces are solved in closed form, static circles are found through the grid.
+// The result is cached until the launch parameters or gravity change.
+struct TrajectoryPreview
+{
+	static constexpr int SEGMENTS = 64; // Chords the arc is split into for the grid search and drawing
+	float maxTime = 10.0f; // Seconds of flight to look ahead
+
+	// Inputs of the cached result
+	Vector2 origin = Vector2Zeros;
+	Vector2 velocity = Vector2Zeros;
+	Vector2 gravity = Vector2Zeros;
+	float radius = 0.0f;
+	bool valid = false;
+
+	// Cached result
+	bool hit = false;
+	BodyHandle hitBody = BODY_HANDLE_NONE; // Kept across steps, which may move the body to another index
+	float hitTime = 0.0f;
+	std::vector<Vector2> points; // Arc up to the hit (or maxTime)
+
+	Vector2 PositionAt(float t) const
+	{
+		return origin + velocity * t + gravity * (0.5f * t * t);
+	}
+
+	// Returns true if the arc was recomputed
+	bool Update(const PhysicsSimulation& sim, Vector2 launchOrigin, Vector2 launchVelocity, float launchRadius)
+	{
+		if (valid && Vector2Equals(origin, launchOrigin) && Vector2Equals(velocity, launchVelocity) &&
+			Vector2Equals(gravity, sim.gravity) && radius == launchRadius)
+			return false;
+
+		origin = launchOrigin;
+		velocity = launchVelocity;
+		gravity = sim.gravity;
+		radius = launchRadius;
+		valid = true;
+
+		hit = false;
+		hitBody = BODY_HANDLE_NONE;
+		hitTime = maxTime;
+
+		// Half-spaces: n.(p(t) - h) = r is a quadratic in t
+		for (int i = 0; i < (int)sim.objects.size(); ++i)
+		{
+			const PhysicsBody& o = sim.objects[i];
+			if (o.colliderType != COLLIDER_TYPE_HALF_SPACE)
+				continue;
+
+			Vector2 n = sim.details[i].normal;
+			float a = 0.5f * Vector2DotProduct(gravity, n);
+			float b = Vector2DotProduct(velocity, n);
+			float c = Vector2DotProduct(origin - o.position, n) - radius;
+
+			float t = FirstRoot(a, b, c);
+			if (t >= 0.0f && t < hitTime)
+			{
+				hit = true;
+				hitBody = HandleOf(sim, i);
+				hitTime = t;
+			}
+		}
+
+		// Static circles: walk the arc chord by chord, asking the grid for circles near each chord.
+		// The arc bulges at most |g| dt^2 / 8 away from a chord, so the search box is padded by that.
+		float segmentTime = maxTime / SEGMENTS;
+		float sag = Vector2Length(gravity) * segmentTime * segmentTime * 0.125f;
+		for (int s = 0; s < SEGMENTS && s * segmentTime < hitTime; ++s)
+		{
+			float t0 = s * segmentTime;
+			float t1 = t0 + segmentTime;
+			Vector2 p0 = PositionAt(t0);
+			Vector2 p1 = PositionAt(t1);
+			Vector2 pad = { radius + sag, radius + sag };
+			Vector2 boxMin = Vector2Min(p0, p1) - pad;
+			Vector2 boxMax = Vector2Max(p0, p1) + pad;
+
+			int candidates[64];
+			int count = sim.QueryAABB({ boxMin.x, boxMin.y, boxMax.x - boxMin.x, boxMax.y - boxMin.y }, candidates, 64);
+			for (int k = 0; k < count; ++k)
+			{
+				const PhysicsBody& o = sim.objects[candidates[k]];
+				if (o.colliderType != COLLIDER_TYPE_CIRCLE || !o.IsStatic())
+					continue;
+
+				float t = FirstContactWithCircle(o.position, o.radius + radius, t0, t1);
+				if (t >= 0.0f && t < hitTime)
+				{
+					hit = true;
+					hitBody = HandleOf(sim, candidates[k]);
+					hitTime = t;
+				}
+			}
+		}
+
+		points.resize(SEGMENTS + 1);
+		for (int s = 0; s <= SEGMENTS; ++s)
+			points[s] = PositionAt(hitTime * s / SEGMENTS);
+		return true;
+	}
+
+	// Handle of body i, none for a body added since the last step that doesn't have one yet
+	static BodyHandle HandleOf(const PhysicsSimulation& sim, int i)
+	{
+		return i < (int)sim.details.size() ? sim.details[i].handle : BODY_HANDLE_NONE;
+	}
+
+	// Smallest non-negative root of a t^2 + b t + c, or -1 if there is none
+	static float FirstRoot(float a, float b, float c)
+	{
+		if (c <= 0.0f)
+			return 0.0f; // Already touching
+
+		if (fabsf(a) < 1e-6f)
+			return b < 0.0f ? -c / b : -1.0f;
+
+		float discriminant = b * b - 4.0f * a * c;
+		if (discriminant < 0.0f)
+			return -1.0f;
+
+		float root = sqrtf(discriminant);
+		float t0 = (-b - root) / (2.0f * a);
+		float t1 = (-b + root) / (2.0f * a);
+		if (t0 > t1)
+			std::swap(t0, t1);
+		return t0 >= 0.0f ? t0 : (t1 >= 0.0f ? t1 : -1.0f);
+	}
+
+	// First time in [t0, t1] the arc comes within distance of center, or -1
+	float FirstContactWithCircle(Vector2 center, float distance, float t0, float t1) const
+	{
+		auto gap = [&](float t) { return Vector2DistanceSqr(PositionAt(t), center) - distance * distance; };
+
+		if (gap(t0) <= 0.0f)
+			return t0;
+
+		// Closest point of the chord to the circle tells us where the arc dips deepest
+		Vector2 p0 = PositionAt(t0);
+		Vector2 chord = PositionAt(t1) - p0;
+		float lengthSqr = Vector2LengthSqr(chord);
+		float s = lengthSqr > 0.0f ? Clamp(Vector2DotProduct(center - p0, chord) / lengthSqr, 0.0f, 1.0f) : 0.0f;
+		float deepest = Lerp(t0, t1, s);
+		if (gap(deepest) > 0.0f)
+		{
+			deepest = t1;
+			if (gap(deepest) > 0.0f)
+				return -1.0f;
+		}
+
+		// Bisect between the outside start and the inside point
+		float lo = t0, hi = deepest;
+		for (int i = 0; i < 24; ++i)
+		{
+			float mid = 0.5f * (lo + hi);
+			if (gap(mid) > 0.0f)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return hi;
+	}
+};
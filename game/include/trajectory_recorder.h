@@ -0,0 +1,161 @@
+/*
+Records the position and velocity of every body at every step into a compact file.
+
+Values are quantized to fixed point. Steps are grouped into chunks: the first step of a chunk is
+a keyframe stored as is, every later step is XORed with the one before it so bodies that barely
+moved turn into runs of zero bytes, and the bytes are stored grouped by significance. Whole chunks are deflated on a background thread and an index
+of chunks is written at the end of the file, so a reader can jump to any step by decoding one chunk.
+
+File layout:
+	TrajectoryFileHeader
+	chunks: TrajectoryChunkHeader + compressed bytes
+	index: TrajectoryIndexEntry per chunk
+	TrajectoryFileFooter
+*/
+
+#pragma once
+
+#include "physics.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct TrajectoryFileHeader
+{
+	char magic[4] = { 'P', 'T', 'R', 'J' };
+	uint32_t version = 1;
+	float timeStep = 0.0f;
+	float quantization = 0.0f; // Units per fixed point step
+};
+
+struct TrajectoryChunkHeader
+{
+	uint64_t firstStep;
+	uint32_t stepCount;
+	uint32_t bodyCount; // Constant within a chunk, a change of body count starts a new one
+	uint32_t rawSize;
+	uint32_t compressedSize;
+};
+
+struct TrajectoryIndexEntry
+{
+	uint64_t firstStep;
+	uint32_t stepCount;
+	uint32_t bodyCount;
+	uint64_t offset; // Of the chunk header
+};
+
+struct TrajectoryFileFooter
+{
+	uint64_t indexOffset;
+	uint32_t chunkCount;
+	char magic[4] = { 'P', 'T', 'R', 'I' };
+};
+
+struct TrajectorySample
+{
+	Vector2 position;
+	Vector2 velocity;
+};
+
+class TrajectoryRecorder
+{
+public:
+	TrajectoryRecorder() = default;
+	~TrajectoryRecorder() { Close(); }
+
+	TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+	TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+	// keyframeInterval = steps per chunk, quantization = smallest difference kept in positions and velocities
+	bool Open(const char* path, float timeStep, int keyframeInterval = 50, float quantization = 1.0f / 64.0f);
+
+	// Finishes the open chunk, waits for the background thread and writes the index
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+	// Call after every step. Only quantizes into memory, compression and file writes happen on the background thread.
+	// When MAX_PENDING_CHUNKS chunks already wait for that thread, the step that finishes a chunk waits too.
+	void Record(const PhysicsSimulation& sim);
+
+	uint64_t RecordedSteps() const { return recordedSteps; }
+	uint64_t RawBytes() const; // Before compression, of the chunks written so far
+	uint64_t CompressedBytes() const;
+	uint64_t StalledChunks() const; // Chunks Record() had to wait to hand over, the background thread fell behind
+
+	static constexpr size_t MAX_PENDING_CHUNKS = 8;
+
+private:
+	struct Chunk
+	{
+		TrajectoryChunkHeader header;
+		std::vector<unsigned char> data;
+	};
+
+	FILE* file = nullptr;
+	int keyframeInterval = 50;
+	float inverseQuantization = 64.0f;
+	uint64_t recordedSteps = 0;
+
+	// Filled by Record()
+	Chunk current;
+	std::vector<int32_t> previous; // Quantized values of the last step, for the XOR
+
+	// Hand-off to the compression thread, the lock is only held to move a chunk in or out
+	std::thread worker;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable drained; // The worker took a chunk out of pending
+	std::deque<Chunk> pending; // At most MAX_PENDING_CHUNKS, so a slow disk can't grow it without bound
+	uint64_t stalledChunks = 0;
+	std::vector<std::vector<unsigned char>> spareBuffers; // Chunk buffers the worker is done with
+	bool stopping = false;
+
+	// Only touched by the worker, until Close() joins it
+	std::vector<TrajectoryIndexEntry> index;
+	std::vector<unsigned char> planes;
+	std::vector<unsigned char> compressed;
+	uint64_t fileOffset = 0;
+	uint64_t rawBytes = 0;
+	uint64_t compressedBytes = 0;
+
+	void FlushChunk();
+	void WorkerLoop();
+};
+
+class TrajectoryReader
+{
+public:
+	TrajectoryReader() = default;
+	~TrajectoryReader() { Close(); }
+
+	TrajectoryReader(const TrajectoryReader&) = delete;
+	TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	uint64_t FirstStep() const { return index.empty() ? 0 : index.front().firstStep; }
+	uint64_t LastStep() const { return index.empty() ? 0 : index.back().firstStep + index.back().stepCount - 1; }
+	int ChunkCount() const { return (int)index.size(); }
+	float TimeStep() const { return header.timeStep; }
+
+	// Fills samples with every body at the given step, false if the step wasn't recorded.
+	// Reading steps in order only decodes each chunk once.
+	bool Seek(uint64_t step, std::vector<TrajectorySample>& samples);
+
+private:
+	FILE* file = nullptr;
+	TrajectoryFileHeader header;
+	std::vector<TrajectoryIndexEntry> index;
+
+	// Decoded chunk, frames are already un-XORed
+	int loadedChunk = -1;
+	std::vector<unsigned char> raw;
+	std::vector<unsigned char> planes;
+	std::vector<unsigned char> compressed;
+
+	bool LoadChunk(int chunk);
+};
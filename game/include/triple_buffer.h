@@ -0,0 +1,42 @@
+/*
+Lock-free hand-off of the latest value from one writer thread to one reader thread.
+The writer fills Back() and calls Publish(), the reader calls Acquire() and reads Front().
+Neither side ever waits, the reader just sees the newest value published so far.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer
+{
+	static constexpr uint8_t INDEX_MASK = 3;
+	static constexpr uint8_t FRESH = 4; // Set while the shared buffer holds a value the reader hasn't taken
+
+	T buffers[3];
+	std::atomic<uint8_t> shared{ 1 };
+	uint8_t back = 0; // Only touched by the writer
+	uint8_t front = 2; // Only touched by the reader
+
+public:
+	// Writer side
+	T& Back() { return buffers[back]; }
+
+	void Publish()
+	{
+		back = shared.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Reader side, returns true if a newer value was taken
+	bool Acquire()
+	{
+		if (!(shared.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		front = shared.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& Front() const { return buffers[front]; }
+};
@@ -0,0 +1,85 @@
+/*
+Runs many independent PhysicsSimulation worlds in one process on a shared thread pool.
+Each step call hands every world to the pool as one task, idle workers steal tasks from
+busy ones so a few heavy worlds don't hold up the rest.
+*/
+
+#pragma once
+
+#include "physics.h"
+#include "triple_buffer.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Copy of a world's bodies published after its last step
+struct WorldSnapshot
+{
+	uint64_t step = 0;
+	std::vector<PhysicsBody> bodies;
+};
+
+struct WorldTiming
+{
+	uint64_t steps = 0;
+	double lastMs = 0.0; // Cost of the most recent step
+	double averageMs = 0.0;
+	double maxMs = 0.0;
+};
+
+class WorldScheduler
+{
+	struct World
+	{
+		PhysicsSimulation sim;
+		WorldTiming timing;
+		TripleBuffer<WorldSnapshot> snapshots;
+	};
+
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<int> tasks; // Owner pops from the front, thieves take from the back
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<World>> worlds;
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake; // Workers sleep on this between batches
+	std::condition_variable done; // Step() waits on this for the batch to finish
+	uint64_t batch = 0;
+	std::atomic<int> pending{ 0 };
+	int stepsPerTask = 1;
+	bool stopping = false;
+
+	void WorkerLoop(int self);
+	bool TakeTask(int self, int& task);
+	void RunTask(int task);
+
+public:
+	explicit WorldScheduler(int threadCount = 0); // 0 = one per hardware thread
+	~WorldScheduler();
+
+	WorldScheduler(const WorldScheduler&) = delete;
+	WorldScheduler& operator=(const WorldScheduler&) = delete;
+
+	// Adds a world and returns its id. Not allowed while Step() runs.
+	int AddWorld(const PhysicsSimulation& sim);
+	int WorldCount() const { return (int)worlds.size(); }
+	int ThreadCount() const { return (int)workers.size(); }
+
+	// Advances every world by steps steps and blocks until all of them are done
+	void Step(int steps = 1);
+
+	// Direct access, only between Step() calls
+	PhysicsSimulation& GetWorld(int id) { return worlds[id]->sim; }
+	const WorldTiming& GetTiming(int id) const { return worlds[id]->timing; }
+
+	// Newest published snapshot of a world. Lock-free and safe to call while Step() runs
+	// on another thread, but only from one reader thread per world.
+	const WorldSnapshot& LatestSnapshot(int id);
+};
@@ -0,0 +1,142 @@
+/*
+Streams a level too large to keep resident into a PhysicsSimulation, in square chunks around a camera.
+
+By Chebyshev distance in chunks from the chunk the camera is in:
+	<= activeRadius   active: the chunk's bodies are in the simulation
+	<= loadRadius     asleep: its bodies wait in memory, outside the simulation
+	further           unloaded: saved to a file in directory (or to memory when it's empty) and dropped
+
+A chunk goes back one state only once it's a chunk further out than the radius that let it in,
+so a camera on a chunk border doesn't bounce chunks in and out. Reading, generating and writing
+chunks happens on a background thread, Update() only hands jobs over and picks up what's done.
+A chunk that was never saved is filled by generate, called on that thread.
+
+Floating origin: once the camera is more than rebaseDistance chunks from the simulation's 0,0,
+Update() moves the world by whole chunks so the camera is near 0,0 again and float positions
+stay as precise there as at the start. Positions are relative to Origin(), the chunk at 0,0.
+
+Only circles are streamed, half-spaces are infinite and stay in the simulation. A body that
+leaves the simulation loses its handle, it gets a new one when its chunk comes back.
+*/
+
+#pragma once
+
+#include "physics.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct ChunkCoord
+{
+	int x, y;
+};
+
+struct WorldStreamingSettings
+{
+	float chunkSize = 1024.0f;
+	int activeRadius = 1;
+	int loadRadius = 2;
+	int rebaseDistance = 4; // Chunks the camera may get from the origin before the world is moved
+	std::string directory; // Where unloaded chunks are saved, empty keeps them in memory
+
+	// Fills a chunk that was never saved, positions relative to the chunk's corner. Called on the background thread.
+	std::function<void(ChunkCoord chunk, std::vector<PhysicsBodyDef>& bodies)> generate;
+};
+
+struct WorldStreamingStats
+{
+	int activeChunks = 0;
+	int sleepingChunks = 0;
+	int loadingChunks = 0; // Requested, not back from the background thread yet
+	int sleepingBodies = 0; // Held by sleeping chunks
+	uint64_t loads = 0;
+	uint64_t unloads = 0;
+	uint64_t rebases = 0;
+};
+
+class WorldStreamer
+{
+public:
+	explicit WorldStreamer(const WorldStreamingSettings& settings);
+	~WorldStreamer(); // Finishes the saves still queued
+
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+	// Call between steps, on the thread that steps sim. camera is in simulation coordinates.
+	// Returns how far the world was moved, subtract it from anything else kept in simulation coordinates.
+	Vector2 Update(PhysicsSimulation& sim, Vector2 camera);
+
+	// Update() until every chunk within activeRadius of camera is active, blocking on the background thread.
+	// For the start, a teleport, or a headless loop that steps faster than chunks load. Returns the shift like Update().
+	Vector2 WaitForActive(PhysicsSimulation& sim, Vector2 camera);
+
+	ChunkCoord Origin() const { return origin; }
+	Vector2 ToSimulation(ChunkCoord chunk, Vector2 local) const; // A position in a chunk, relative to its corner
+	ChunkCoord ChunkAt(Vector2 position) const; // Of a position in simulation coordinates
+
+	const WorldStreamingStats& Stats() const { return stats; }
+	const WorldStreamingSettings& Settings() const { return settings; }
+
+private:
+	enum ChunkState
+	{
+		CHUNK_LOADING,
+		CHUNK_SLEEPING,
+		CHUNK_ACTIVE
+	};
+
+	struct Chunk
+	{
+		ChunkCoord coord;
+		ChunkState state;
+		std::vector<PhysicsBodyDef> bodies; // While sleeping, positions relative to the chunk's corner
+	};
+
+	struct Job
+	{
+		ChunkCoord coord;
+		bool save; // Otherwise load
+		std::vector<PhysicsBodyDef> bodies;
+	};
+
+	WorldStreamingSettings settings;
+	float inverseChunkSize;
+	ChunkCoord origin = { 0, 0 };
+	std::unordered_map<uint64_t, Chunk> chunks; // Every chunk that isn't unloaded
+	std::vector<int> leaving; // Scratch for Update(), indices of bodies moving into sleeping chunks
+	WorldStreamingStats stats;
+
+	// Hand-off to the background thread, the lock is only held to move jobs in or out
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished; // A load was moved to loaded
+	std::deque<Job> requests; // In order, so a chunk is always saved before it's loaded again
+	std::deque<Job> loaded;
+	bool stopping = false;
+
+	// Saved chunks when there's no directory, only touched by the worker
+	std::unordered_map<uint64_t, std::vector<unsigned char>> stored;
+
+	static uint64_t Key(ChunkCoord c) { return (uint64_t)(uint32_t)c.x << 32 | (uint32_t)c.y; }
+	static int Distance(ChunkCoord a, ChunkCoord b) { return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)); }
+
+	Vector2 Corner(ChunkCoord chunk) const; // In simulation coordinates
+	bool ActiveAround(ChunkCoord center) const; // Every chunk within activeRadius is active
+	void RequestLoad(ChunkCoord coord);
+	void RequestSave(Chunk& chunk);
+	void Activate(PhysicsSimulation& sim, Chunk& chunk);
+	void CollectLeavingBodies(PhysicsSimulation& sim, ChunkCoord center);
+
+	void WorkerLoop();
+	void Load(Job& job);
+	void Save(const Job& job);
+	std::string ChunkPath(ChunkCoord coord) const;
+};
@@ -0,0 +1,227 @@
+#include "batch.h"
+#include "input_replay.h"
+#include "launch_sweep.h"
+#include "trajectory_recorder.h"
+#include "world_scheduler.h"
+#include "world_streamer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool IsBatchCommand(int argc, char** argv)
+{
+	return argc > 1 && (strcmp(argv[1], "--sweep") == 0 || strcmp(argv[1], "--worlds") == 0 ||
+		strcmp(argv[1], "--trajectory") == 0 || strcmp(argv[1], "--replay") == 0 || strcmp(argv[1], "--stream") == 0);
+}
+
+static int RunSweep(int argc, char** argv, const PhysicsSimulation& scene, const LaunchControls& launch)
+{
+	LaunchSweepSettings settings;
+	settings.launchPosition = launch.position;
+	settings.launchRadius = launch.radius;
+	if (argc > 3)
+		settings.target = { (float)atof(argv[2]), (float)atof(argv[3]) };
+
+	PrintLaunchSweep(RunLaunchSweep(scene, settings), stdout);
+	return 0;
+}
+
+static int RunWorlds(int argc, char** argv, const PhysicsSimulation& scene)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: --worlds count [steps]\n");
+		return 1;
+	}
+
+	int worldCount = atoi(argv[2]);
+	int steps = argc > 3 ? atoi(argv[3]) : 500;
+
+	WorldScheduler scheduler;
+	for (int i = 0; i < worldCount; ++i)
+	{
+		// Vary the scenes a little so the worlds don't all cost the same
+		PhysicsSimulation world = scene;
+		for (int k = 0; k < i % 16 && !world.objects.empty(); ++k)
+		{
+			PhysicsBody b = world.objects[0];
+			b.position.x += 45.0f * (k + 1) - 360.0f;
+			world.objects.push_back(b);
+			world.details.push_back(world.details[0]); // A half-space needs its normal, the handle is replaced
+		}
+		scheduler.AddWorld(world);
+	}
+
+	scheduler.Step(steps);
+
+	for (int i = 0; i < scheduler.WorldCount(); ++i)
+	{
+		const WorldTiming& timing = scheduler.GetTiming(i);
+		printf("world %d: %d bodies, %llu steps, avg %.4f ms, max %.4f ms\n", i,
+			(int)scheduler.LatestSnapshot(i).bodies.size(), (unsigned long long)timing.steps, timing.averageMs, timing.maxMs);
+	}
+	return 0;
+}
+
+// Summary of a recording made with --record, and the bodies at one step of it
+static int RunTrajectory(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: --trajectory file [step]\n");
+		return 1;
+	}
+
+	TrajectoryReader reader;
+	if (!reader.Open(argv[2]))
+	{
+		fprintf(stderr, "can't read trajectory %s\n", argv[2]);
+		return 1;
+	}
+
+	printf("steps %llu to %llu in %d chunks, %.4f s per step\n", (unsigned long long)reader.FirstStep(),
+		(unsigned long long)reader.LastStep(), reader.ChunkCount(), reader.TimeStep());
+
+	uint64_t step = argc > 3 ? strtoull(argv[3], nullptr, 10) : reader.LastStep();
+	std::vector<TrajectorySample> samples;
+	if (!reader.Seek(step, samples))
+	{
+		fprintf(stderr, "step %llu not recorded\n", (unsigned long long)step);
+		return 1;
+	}
+
+	printf("step %llu: %d bodies\n", (unsigned long long)step, (int)samples.size());
+	for (int i = 0; i < (int)samples.size(); ++i)
+		printf("%5d  position %10.3f %10.3f  velocity %10.3f %10.3f\n", i,
+			samples[i].position.x, samples[i].position.y, samples[i].velocity.x, samples[i].velocity.y);
+	return 0;
+}
+
+// Fast-forwards a recorded session without a window and checks it ends where the recording did
+static int RunReplay(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: --replay file\n");
+		return 1;
+	}
+
+	// The recording carries its own starting state
+	PhysicsSimulation sim;
+	LaunchControls launch;
+	InputReplay replay;
+	if (!replay.Open(argv[2], sim, launch))
+	{
+		fprintf(stderr, "can't read replay %s\n", argv[2]);
+		return 1;
+	}
+
+	double startTime = sim.SimulationTime();
+	auto start = std::chrono::steady_clock::now();
+	while (replay.Apply(sim, launch))
+		sim.Step(sim.NextTimeStep(replay.TimeStep()));
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double played = sim.SimulationTime() - startTime;
+	printf("replayed %llu steps (%.1f s of play) in %.3f s, %.0fx real time, %d bodies\n", (unsigned long long)sim.StepCount(),
+		played, seconds, seconds > 0.0 ? played / seconds : 0.0, (int)sim.objects.size());
+
+	if (!replay.HasEndHash())
+	{
+		printf("recording has no final state to compare with\n");
+		return 0;
+	}
+
+	bool matches = replay.Matches(sim);
+	printf("final state %s the recording\n", matches ? "matches" : "differs from");
+	return matches ? 0 : 1;
+}
+
+// Pegs and falling circles, the same for a chunk every time it's generated
+static void GenerateChunk(ChunkCoord chunk, std::vector<PhysicsBodyDef>& bodies)
+{
+	uint32_t seed = (uint32_t)chunk.x * 73856093u ^ (uint32_t)chunk.y * 19349663u;
+	auto next = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	};
+
+	for (int i = 0; i < 64; ++i)
+	{
+		PhysicsBodyDef def;
+		def.position = { next() * 1024.0f, next() * 1024.0f };
+		def.colliderType = COLLIDER_TYPE_CIRCLE;
+		def.collider.circle.radius = 4.0f + next() * 12.0f;
+		bool peg = i < 16;
+		def.gravityScale = peg ? 0.0f : 1.0f;
+		def.velocity = peg ? Vector2Zeros : Vector2{ next() * 100.0f - 50.0f, 0.0f };
+		def.color = peg ? GRAY : BLUE;
+		bodies.push_back(def);
+	}
+}
+
+// Flies a camera diagonally across a world far bigger than the simulation ever holds
+static int RunStream(int argc, char** argv)
+{
+	int steps = argc > 2 ? atoi(argv[2]) : 3000;
+
+	WorldStreamingSettings settings;
+	settings.generate = GenerateChunk;
+	if (argc > 3)
+		settings.directory = argv[3];
+
+	PhysicsSimulation sim;
+	WorldStreamer streamer(settings);
+	Vector2 camera = Vector2Zeros;
+	Vector2 cameraVelocity = { 2000.0f, 1200.0f };
+	float dt = 1.0f / sim.TARGET_FPS;
+
+	size_t maxBodies = 0;
+	double stepMs = 0.0;
+	for (int step = 0; step < steps; ++step)
+	{
+		// Steps here take far less than a frame, without waiting the camera would outrun the loader over empty chunks
+		camera += cameraVelocity * dt;
+		camera -= streamer.WaitForActive(sim, camera);
+
+		auto start = std::chrono::steady_clock::now();
+		sim.Step(dt);
+		stepMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		maxBodies = std::max(maxBodies, sim.objects.size());
+	}
+
+	const WorldStreamingStats& stats = streamer.Stats();
+	ChunkCoord cameraChunk = streamer.ChunkAt(camera);
+	printf("camera in chunk %d,%d at (%.1f, %.1f) from origin chunk %d,%d\n", cameraChunk.x, cameraChunk.y,
+		camera.x, camera.y, streamer.Origin().x, streamer.Origin().y);
+	printf("%d bodies in the simulation (max %d), %d active + %d sleeping chunks holding %d more, %d loading\n",
+		(int)sim.objects.size(), (int)maxBodies, stats.activeChunks, stats.sleepingChunks, stats.sleepingBodies, stats.loadingChunks);
+	printf("%llu loads, %llu unloads, %llu rebases, avg step %.4f ms\n", (unsigned long long)stats.loads,
+		(unsigned long long)stats.unloads, (unsigned long long)stats.rebases, steps > 0 ? stepMs / steps : 0.0);
+
+	if (steps > 0 && stats.loads == 0)
+	{
+		fprintf(stderr, "no chunk was loaded\n");
+		return 1;
+	}
+	return 0;
+}
+
+int RunBatchCommand(int argc, char** argv, const PhysicsSimulation& scene, const LaunchControls& launch)
+{
+	if (strcmp(argv[1], "--sweep") == 0)
+		return RunSweep(argc, argv, scene, launch);
+	if (strcmp(argv[1], "--worlds") == 0)
+		return RunWorlds(argc, argv, scene);
+	if (strcmp(argv[1], "--trajectory") == 0)
+		return RunTrajectory(argc, argv);
+	if (strcmp(argv[1], "--replay") == 0)
+		return RunReplay(argc, argv);
+	if (strcmp(argv[1], "--stream") == 0)
+		return RunStream(argc, argv);
+
+	fprintf(stderr, "unknown command %s\n", argv[1]);
+	return 1;
+}
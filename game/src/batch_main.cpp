@@ -0,0 +1,25 @@
+/*
+Headless entry point: runs the batch commands without linking raylib or opening a window.
+*/
+
+#include "batch.h"
+#include "scenes.h"
+#include <cstdio>
+
+int main(int argc, char** argv)
+{
+	if (!IsBatchCommand(argc, argv))
+	{
+		fprintf(stderr,
+			"usage: physics-batch --sweep [targetX targetY]\n"
+			"       physics-batch --worlds count [steps]\n"
+			"       physics-batch --trajectory file [step]\n"
+			"       physics-batch --replay file\n"
+			"       physics-batch --stream [steps] [dir]\n");
+		return 1;
+	}
+
+	PhysicsSimulation scene;
+	BuildFunnelScene(scene);
+	return RunBatchCommand(argc, argv, scene, LaunchControls());
+}
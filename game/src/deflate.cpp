@@ -0,0 +1,61 @@
+#include "deflate.h"
+#include <cstring>
+
+#if defined(PHYSICS_BUNDLED_DEFLATE)
+
+#define SDEFL_IMPLEMENTATION
+#include "external/sdefl.h"
+#define SINFL_IMPLEMENTATION
+#include "external/sinfl.h"
+#include <memory>
+
+// Fastest level: CompressData() uses 8, which is ten times slower for a few percent on recorded trajectories
+static const int DEFLATE_LEVEL = 1;
+
+bool DeflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out)
+{
+	// The compressor state is almost 1MB, keep one per thread instead of allocating it every call
+	static thread_local std::unique_ptr<sdefl> state(new sdefl());
+
+	out.resize(sdefl_bound(size));
+	int compressedSize = sdeflate(state.get(), out.data(), data, size, DEFLATE_LEVEL);
+	out.resize(compressedSize > 0 ? compressedSize : 0);
+	return compressedSize > 0 || size == 0;
+}
+
+bool InflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out)
+{
+	return sinflate(out.data(), (int)out.size(), data, size) == (int)out.size();
+}
+
+#else
+
+#include "raylib.h"
+
+bool DeflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out)
+{
+	int compressedSize = 0;
+	unsigned char* compressed = CompressData(data, size, &compressedSize);
+	if (!compressed)
+		return false;
+
+	out.assign(compressed, compressed + compressedSize);
+	MemFree(compressed);
+	return true;
+}
+
+bool InflateBytes(const unsigned char* data, int size, std::vector<unsigned char>& out)
+{
+	int rawSize = 0;
+	unsigned char* raw = DecompressData(data, size, &rawSize);
+	if (!raw)
+		return false;
+
+	bool ok = rawSize == (int)out.size();
+	if (ok)
+		memcpy(out.data(), raw, rawSize);
+	MemFree(raw);
+	return ok;
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "input_replay.h"
+#include <cstring>
+
+uint64_t HashBodies(const PhysicsSimulation& sim)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	};
+
+	uint64_t count = sim.objects.size();
+	mix(&count, sizeof(count));
+	for (const PhysicsBody& o : sim.objects)
+	{
+		mix(&o.position, sizeof(o.position));
+		mix(&o.velocity, sizeof(o.velocity));
+	}
+	return hash;
+}
+
+InputRecorder::~InputRecorder()
+{
+	// Without a final state there's no END event, a replay then just runs to the last input
+	if (file)
+		fclose(file);
+}
+
+bool InputRecorder::Open(const char* path, const PhysicsSimulation& sim, const LaunchControls& launch, float timeStep)
+{
+	if (file)
+		fclose(file);
+
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> snapshot;
+	sim.SaveSnapshot(snapshot);
+
+	InputReplayHeader header;
+	header.timeStep = timeStep;
+	header.launch = launch;
+	header.snapshotSize = (uint32_t)snapshot.size();
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(snapshot.data(), 1, snapshot.size(), file);
+	return true;
+}
+
+void InputRecorder::RecordKey(const PhysicsSimulation& sim, int key)
+{
+	Write(sim, INPUT_EVENT_KEY_PRESSED, key, 0.0f);
+}
+
+void InputRecorder::RecordChanges(const PhysicsSimulation& sim, const LaunchControls& before, const LaunchControls& after)
+{
+	if (after.angle != before.angle)
+		Write(sim, INPUT_EVENT_LAUNCH_ANGLE, 0, after.angle);
+	if (after.speed != before.speed)
+		Write(sim, INPUT_EVENT_LAUNCH_SPEED, 0, after.speed);
+	if (after.position.x != before.position.x)
+		Write(sim, INPUT_EVENT_LAUNCH_X, 0, after.position.x);
+}
+
+void InputRecorder::Close(const PhysicsSimulation& sim)
+{
+	if (!file)
+		return;
+
+	InputEvent end = {};
+	end.step = sim.StepCount();
+	end.type = INPUT_EVENT_END;
+	end.hash = HashBodies(sim);
+	fwrite(&end, sizeof(end), 1, file);
+
+	fclose(file);
+	file = nullptr;
+}
+
+void InputRecorder::Write(const PhysicsSimulation& sim, InputEventType type, int key, float value)
+{
+	if (!file)
+		return;
+
+	InputEvent event = {};
+	event.step = sim.StepCount();
+	event.type = type;
+	event.key = key;
+	event.value = value;
+	fwrite(&event, sizeof(event), 1, file);
+}
+
+bool InputReplay::Open(const char* path, PhysicsSimulation& sim, LaunchControls& launch)
+{
+	Close();
+
+	file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	InputReplayHeader expected;
+	std::vector<unsigned char> snapshot;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+		header.version == expected.version;
+	if (ok)
+	{
+		snapshot.resize(header.snapshotSize);
+		ok = fread(snapshot.data(), 1, snapshot.size(), file) == snapshot.size() && sim.RestoreSnapshot(snapshot.data(), snapshot.size());
+	}
+
+	if (!ok)
+	{
+		Close();
+		return false;
+	}
+
+	// The snapshot leaves the grid empty, queries made before the first step need it
+	sim.UpdateBroadphase();
+	launch = header.launch;
+	hasEnd = false;
+	ReadNext();
+	return true;
+}
+
+void InputReplay::Close()
+{
+	if (file)
+		fclose(file);
+	file = nullptr;
+	hasNext = false;
+}
+
+bool InputReplay::Apply(PhysicsSimulation& sim, LaunchControls& launch)
+{
+	while (hasNext && next.step <= sim.StepCount())
+	{
+		switch (next.type)
+		{
+		case INPUT_EVENT_KEY_PRESSED: ApplyLaunchKey(launch, sim, next.key); break;
+		case INPUT_EVENT_LAUNCH_ANGLE: launch.angle = next.value; break;
+		case INPUT_EVENT_LAUNCH_SPEED: launch.speed = next.value; break;
+		case INPUT_EVENT_LAUNCH_X: launch.position.x = next.value; break;
+		case INPUT_EVENT_END:
+			hasEnd = true;
+			endHash = next.hash;
+			Close();
+			return false;
+		}
+		ReadNext();
+	}
+
+	// A recording cut short without an END stops after its last input
+	return hasNext;
+}
+
+void InputReplay::ReadNext()
+{
+	hasNext = file && fread(&next, sizeof(next), 1, file) == 1;
+}
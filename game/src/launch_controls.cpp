@@ -0,0 +1,46 @@
+#include "launch_controls.h"
+
+const int LAUNCH_KEYS[] = { KEY_SPACE, KEY_U, KEY_I, KEY_O, KEY_P, KEY_J, KEY_K, KEY_L };
+const int LAUNCH_KEY_COUNT = sizeof(LAUNCH_KEYS) / sizeof(LAUNCH_KEYS[0]);
+
+Vector2 LaunchControls::Velocity() const
+{
+	return Vector2Rotate(Vector2UnitX, DEG2RAD * angle) * speed;
+}
+
+void LaunchControls::Launch(PhysicsSimulation& sim) const
+{
+	PhysicsBodyDef b;
+	b.position = position;
+	b.velocity = Velocity();
+	b.colliderType = COLLIDER_TYPE_CIRCLE;
+	b.collider.circle.radius = radius;
+	b.color = GREEN;
+
+	sim.AddBody(b);
+}
+
+bool ApplyLaunchPreset(LaunchControls& launch, int key)
+{
+	switch (key)
+	{
+	case KEY_U: launch.angle = 0; break;
+	case KEY_I: launch.angle = 45; break;
+	case KEY_O: launch.angle = 60; break;
+	case KEY_P: launch.angle = 90; break;
+	case KEY_J: launch.angle = 315; break;
+	case KEY_K: launch.angle = 300; break;
+	case KEY_L: launch.angle = 270; break;
+	default: return false;
+	}
+	return true;
+}
+
+bool ApplyLaunchKey(LaunchControls& launch, PhysicsSimulation& sim, int key)
+{
+	if (key != KEY_SPACE)
+		return ApplyLaunchPreset(launch, key);
+
+	launch.Launch(sim);
+	return true;
+}
@@ -0,0 +1,126 @@
+#include "launch_sweep.h"
+#include <chrono>
+#include <thread>
+
+static float StepValue(float min, float max, int steps, int i)
+{
+	return steps > 1 ? min + (max - min) * i / (steps - 1) : min;
+}
+
+float LaunchSweepResult::Angle(int launch) const
+{
+	return StepValue(settings.minAngle, settings.maxAngle, settings.angleSteps, launch % settings.angleSteps);
+}
+
+float LaunchSweepResult::Speed(int launch) const
+{
+	return StepValue(settings.minSpeed, settings.maxSpeed, settings.speedSteps, launch / settings.angleSteps);
+}
+
+// Simulates launches first, first + stride, ... in a world owned by this worker.
+// Results go to the worker's own slots, nothing else is written.
+static void SweepWorker(const PhysicsSimulation& scene, LaunchSweepResult& result, int first, int stride)
+{
+	const LaunchSweepSettings& s = result.settings;
+	int launchCount = s.angleSteps * s.speedSteps;
+	int maxSteps = (int)(s.maxTime * scene.TARGET_FPS);
+
+	PhysicsSimulation world;
+	for (int launch = first; launch < launchCount; launch += stride)
+	{
+		world = scene;
+
+		PhysicsBodyDef b;
+		b.position = s.launchPosition;
+		b.velocity = Vector2Rotate(Vector2UnitX, DEG2RAD * result.Angle(launch)) * result.Speed(launch);
+		b.colliderType = COLLIDER_TYPE_CIRCLE;
+		b.collider.circle.radius = s.launchRadius;
+		// By handle, the reordering moves bodies to other indices between steps
+		BodyHandle projectile = world.AddBody(b);
+
+		float hitTime = -1.0f;
+		float missDistance = INFINITY;
+		for (int step = 0; step < maxSteps; ++step)
+		{
+			world.Step(1.0f / scene.TARGET_FPS);
+
+			const PhysicsBody* p = world.Find(projectile);
+			if (!p)
+				break; // Culled, a miss
+
+			float gap = Vector2Distance(p->position, s.target) - s.targetRadius - s.launchRadius;
+			missDistance = fminf(missDistance, fmaxf(gap, 0.0f));
+			if (gap <= 0.0f)
+			{
+				hitTime = (step + 1) / (float)scene.TARGET_FPS;
+				break;
+			}
+		}
+
+		result.hitTime[launch] = hitTime;
+		result.missDistance[launch] = missDistance;
+	}
+}
+
+LaunchSweepResult RunLaunchSweep(const PhysicsSimulation& scene, const LaunchSweepSettings& settings)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	LaunchSweepResult result;
+	result.settings = settings;
+	int launchCount = settings.angleSteps * settings.speedSteps;
+	result.hitTime.assign(launchCount, -1.0f);
+	result.missDistance.assign(launchCount, INFINITY);
+
+	int threadCount = settings.threadCount > 0 ? settings.threadCount : (int)std::thread::hardware_concurrency();
+	threadCount = std::max(1, std::min(threadCount, launchCount));
+
+	// Interleaved split so workers get a similar mix of short and long flights
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threadCount; ++t)
+		workers.emplace_back(SweepWorker, std::cref(scene), std::ref(result), t, threadCount);
+	SweepWorker(scene, result, 0, threadCount);
+	for (std::thread& worker : workers)
+		worker.join();
+
+	for (int launch = 0; launch < launchCount; ++launch)
+	{
+		if (result.Hit(launch))
+		{
+			result.hitCount++;
+			if (result.best < 0 || !result.Hit(result.best) || result.hitTime[launch] < result.hitTime[result.best])
+				result.best = launch;
+		}
+		else if (result.best < 0 || (!result.Hit(result.best) && result.missDistance[launch] < result.missDistance[result.best]))
+			result.best = launch;
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+void PrintLaunchSweep(const LaunchSweepResult& result, FILE* out)
+{
+	const LaunchSweepSettings& s = result.settings;
+	fprintf(out, "Launch sweep: %d angles x %d speeds, target (%.1f, %.1f) r=%.1f\n",
+		s.angleSteps, s.speedSteps, s.target.x, s.target.y, s.targetRadius);
+	fprintf(out, "Rows: speed %.1f..%.1f, columns: angle %.1f..%.1f, '#' = hit\n",
+		s.minSpeed, s.maxSpeed, s.minAngle, s.maxAngle);
+
+	for (int speed = 0; speed < s.speedSteps; ++speed)
+	{
+		fprintf(out, "%7.1f ", result.Speed(speed * s.angleSteps));
+		for (int angle = 0; angle < s.angleSteps; ++angle)
+			fputc(result.Hit(speed * s.angleSteps + angle) ? '#' : '.', out);
+		fputc('\n', out);
+	}
+
+	int launchCount = s.angleSteps * s.speedSteps;
+	fprintf(out, "%d/%d launches hit in %.3f s\n", result.hitCount, launchCount, result.seconds);
+	if (result.best >= 0 && result.Hit(result.best))
+		fprintf(out, "Best: angle %.2f, speed %.2f, hits after %.2f s\n",
+			result.Angle(result.best), result.Speed(result.best), result.hitTime[result.best]);
+	else if (result.best >= 0)
+		fprintf(out, "No hit, closest: angle %.2f, speed %.2f, missed by %.2f\n",
+			result.Angle(result.best), result.Speed(result.best), result.missDistance[result.best]);
+}
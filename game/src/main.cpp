@@ -6,246 +6,165 @@ See documentation here: https://www.raylib.com/, and examples here: https://www.
 #include "raylib.h"
 #include "raymath.h"
 #define RAYGUI_IMPLEMENTATION
+// raygui frees blocks raylib allocated (DecompressData()), through raylib they go back to the allocator they came from
+#define RAYGUI_MALLOC(sz) MemAlloc((unsigned int)(sz))
+#define RAYGUI_CALLOC(n, sz) MemAlloc((unsigned int)((n) * (sz)))
+#define RAYGUI_FREE(p) MemFree(p)
 #include "raygui.h"
 #include "game.h"
+#include "physics.h"
+#include "scenes.h"
+#include "batch.h"
+#include "profiler.h"
+#include "stats_log.h"
+#include "trajectory_recorder.h"
+#include "input_replay.h"
+#include "sim_thread.h"
+#include <chrono>
+#include <cstring>
 #include <vector>
-#include <cassert>
 
-//struct Circle
-//{
-//	Vector2 position = Vector2Zeros;
-//	float radius = 0.0f;
-//};
+LaunchControls launch; // The render thread's copy, edited by the sliders
 
-enum ColliderType
-{
-	COLLIDER_TYPE_INVALID,
-	COLLIDER_TYPE_CIRCLE,
-	COLLIDER_TYPE_HALF_SPACE
-	// COLLIDER_BOX
-};
-
-// Union to hold different collider types in a single variable
-union Collider
-{
-	struct
-	{
-		float radius;
-	} circle;
-
-	struct
-	{
-		Vector2 normal; // Direction the half-space is facing
-		float distance; // Distance from 0,0
-	} halfSpace;
-};
+bool showProfiler = false;
 
-struct PhysicsBody
+// Rolling zone averages and the frame time graph
+void drawProfilerOverlay(const RenderSnapshot& frame)
 {
-	Vector2 position = Vector2Zeros; 
-	Vector2 velocity = Vector2Zeros;
-	float drag = 1.0f; // No dampening by default
-	// float mass; 
-	float gravityScale = 1.0f;
-	bool collision = false; // If the body collided this frame
-	Color color = MAGENTA;
+	const float frameBudgetMs = 1000.0f / PhysicsSimulation::TARGET_FPS;
+	int zoneCount = Profiler::ZoneCount();
 
-	//float radius = 0.0f;
+	Rectangle panel = { 10, 130, 320, 0 };
+	panel.height = 40.0f + zoneCount * 16.0f + 100.0f + 5 * 14.0f;
+	GuiPanel(panel, Profiler::IsCapturing() ? "Profiler (F1) - recording (F2)" : "Profiler (F1) - F2 records a trace");
 
-	ColliderType colliderType = COLLIDER_TYPE_INVALID;
-	Collider collider{};
-};
-
-class PhysicsSimulation
-{
-	float dt = 1.0f / TARGET_FPS; //seconds/frame
-	float time = 0;
-
-public:
-	const unsigned int TARGET_FPS = 50; //frames/second
-	Vector2 gravity = { 0, 9.81f }; // Gravity acceleration
-	std::vector<PhysicsBody> objects;
-
-	void updateTime()
+	float y = panel.y + 32;
+	for (int i = 0; i < zoneCount; ++i)
 	{
-		dt = 1.0f / TARGET_FPS;
-		time += dt;
+		ProfileZoneStats zone = Profiler::GetZone(i);
+		DrawText(zone.name, (int)panel.x + 10, (int)y, 10, DARKGRAY);
+		DrawText(TextFormat("%7.3f ms", zone.averageMs), (int)panel.x + 150, (int)y, 10, DARKGRAY);
+		y += 16;
 	}
-
-	void UpdateObjectPositions()
+	DrawText(TextFormat("frame %.2f ms", Profiler::AverageFrameMs()), (int)panel.x + 10, (int)y, 10, BLACK);
+
+	// Frame times, full height is twice the budget
+	Rectangle graph = { panel.x + 10, y + 18, panel.width - 20, 70 };
+	float scale = graph.height / (2.0f * frameBudgetMs);
+	float bottom = graph.y + graph.height;
+	DrawRectangleLinesEx(graph, 1, LIGHTGRAY);
+	DrawLineV({ graph.x, bottom - frameBudgetMs * scale }, { graph.x + graph.width, bottom - frameBudgetMs * scale }, ORANGE);
+
+	float frames[Profiler::HISTORY];
+	Profiler::GetFrameHistory(frames);
+	float stepX = graph.width / (Profiler::HISTORY - 1);
+	for (int i = 1; i < Profiler::HISTORY; ++i)
 	{
-		for (int i = 0; i < objects.size(); ++i)
-		{
-			PhysicsBody& o = objects[i];
-			Vector2 acc = gravity * o.gravityScale;
-
-			o.velocity += acc * dt;
-			o.position += o.velocity * dt;
-
-			// Reset every loop
-			o.collision = false;
-		}
-	}
-
-	void CheckCollision()
-	{
-		// No collision possible
-		if (objects.size() < 2)
-			return; 
-
-		for (int i = 0; i < objects.size(); ++i)
-		{
-			for (int j = i + 1; j < objects.size(); ++j)
-			{
-				PhysicsBody& a = objects[i];
-				PhysicsBody& b = objects[j];
-
-				// Ensures both have a type
-				assert(a.colliderType != COLLIDER_TYPE_INVALID && b.colliderType != COLLIDER_TYPE_INVALID);
-				bool collision = false;
-
-				// mtv = minimum translation vector
-				Vector2 mtv = Vector2Zeros;
-				
-				if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_CIRCLE)
-					collision = CircleCircle(
-						a.position, a.collider.circle.radius, 
-						b.position, b.collider.circle.radius,
-						&mtv);
-
-				else if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_HALF_SPACE)
-					collision = CircleHalfSpace(
-						a.position, a.collider.circle.radius,
-						b.position, b.collider.halfSpace.normal,
-						&mtv);
-
-				else if (a.colliderType == COLLIDER_TYPE_HALF_SPACE && b.colliderType == COLLIDER_TYPE_CIRCLE)
-					collision = CircleHalfSpace(
-						b.position, b.collider.circle.radius,
-						a.position, a.collider.halfSpace.normal,
-						&mtv);
-
-				a.collision |= collision;
-				b.collision |= collision; // only if single true
-
-				if (collision)
-				{
-					// move only circles
-					if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_HALF_SPACE)
-						a.position += mtv;
-					if (a.colliderType == COLLIDER_TYPE_HALF_SPACE && b.colliderType == COLLIDER_TYPE_CIRCLE)
-						b.position += mtv; 
-
-					if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_CIRCLE)
-					{
-						// Move both circles apart equally
-						a.position += mtv * 0.5f;
-						b.position -= mtv * 0.5f;
-					}
-				}
-
-			}
-		}
+		float y0 = bottom - fminf(frames[i - 1] * scale, graph.height);
+		float y1 = bottom - fminf(frames[i] * scale, graph.height);
+		DrawLineV({ graph.x + (i - 1) * stepX, y0 }, { graph.x + i * stepX, y1 }, BLUE);
 	}
 
-	bool CircleCircle(Vector2 pos1, float rad1, Vector2 pos2, float rad2, Vector2* mtv = nullptr)
+	// Counters of the last step, tell more bodies apart from more work per body
+	const PhysicsStepStats& stats = frame.stats;
+	y = bottom + 8;
+	DrawText(TextFormat("bodies %d active (%d reduced rate), %d asleep, %d static", stats.activeBodies, stats.reducedRateBodies,
+		stats.sleepingBodies, stats.staticBodies),
+		(int)panel.x + 10, (int)y, 10, DARKGRAY);
+	DrawText(TextFormat("pairs %d, tests %d, hits %d (%.0f%%)", stats.candidatePairs, stats.narrowphaseTests, stats.narrowphaseHits,
+		stats.broadphaseEfficiency * 100.0f), (int)panel.x + 10, (int)y + 14, 10, DARKGRAY);
+	DrawText(TextFormat("resolved %d, spawned %d, culled %d", stats.contactsResolved, stats.bodiesSpawned, stats.bodiesCulled),
+		(int)panel.x + 10, (int)y + 28, 10, DARKGRAY);
+
+	// Budget tier and what it gave up, see PhysicsBudget
+	const char* degraded = "full quality";
+	if (stats.qualityTier > 0)
 	{
-		// distance calculated by pythagorean
-		float distance = Vector2Distance(pos1, pos2);
-
-		// lab 5
-		float radii_sum = rad1 + rad2;
-		bool collision = distance <= radii_sum;
-
-		if (collision && mtv != nullptr)
-		{
-			// direction from circle 2 to circle 1
-			Vector2 direction = Vector2Subtract(pos1, pos2);
-			direction = Vector2Normalize(direction);
-			// overlap distance
-			float overlap = radii_sum - distance;
-			// minimum translation vector
-			*mtv = direction * overlap;
-		}
-
-		// If distance between the two radius are less than or equal to distance calculated
-		return collision;
+		const char* names[BUDGET_DEGRADATION_COUNT] = {};
+		for (int i = 0; i < stats.qualityTier; ++i)
+			names[i] = PhysicsSimulation::DegradationName(frame.degradations[i]);
+		degraded = TextJoin(names, stats.qualityTier, ", ");
 	}
-
-	bool CircleHalfSpace(Vector2 circlePos, float rad, Vector2 posHalfSpace, Vector2 normal, Vector2* mtv = nullptr)
+	DrawText(TextFormat("tier %d (%s), step %.2f ms", stats.qualityTier, degraded, stats.stepCostMs),
+		(int)panel.x + 10, (int)y + 42, 10, stats.qualityTier > 0 ? ORANGE : DARKGRAY);
+
+	// Heap churn of the last frame by raylib's memory tracker, and the subsystem behind most of it
+	unsigned int allocations = 0, mostAllocations = 0;
+	unsigned long long bytes = 0, liveBytes = 0, peakBytes = 0;
+	int busiest = MEMORY_TAG_CORE;
+	for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
 	{
-		// Vector from half-space position to circle position (ab = b - a)
-		Vector2 toCircle = circlePos - posHalfSpace;
-
-		// Determine distance from circle to half-space by scalar projecting AB onto normal
-		float proj = Vector2DotProduct(toCircle, normal);
-
-		// The circle is colliding if its center is closer to the plane than its radius
-		bool collision = proj <= rad;
-
-		if (collision && mtv != nullptr)
+		MemoryTagStats memory = GetMemoryTagStats(tag);
+		allocations += memory.frameAllocCount;
+		bytes += memory.frameAllocBytes;
+		liveBytes += memory.liveBytes;
+		peakBytes += memory.peakBytes;
+		if (memory.frameAllocCount > mostAllocations)
 		{
-			// depth = how far the circle is inside the half-space
-			float depth = rad - proj;
-
-			// MTV pushes the circle out along the plane's normal
-			*mtv = normal * depth;
+			mostAllocations = memory.frameAllocCount;
+			busiest = tag;
 		}
-
-		// Collision if projection less than or equal to radius
-		return collision;
 	}
-
-};
-
-
-Vector2 launchPosition = { 600, 100 };
-float launchAngle = 300.0f;
-float launchSpeed = 150.0f;
+	// raylib allocates as the window opens, nothing ever counted means it was built without the tracker
+	if (peakBytes == 0)
+		DrawText("heap not tracked, build raylib with SUPPORT_MEMORY_TRACKING", (int)panel.x + 10, (int)y + 56, 10, DARKGRAY);
+	else
+		DrawText(TextFormat("heap %u allocs, %.1f KB per frame (%s %u), %.1f MB live", allocations, bytes / 1024.0, GetMemoryTagName(busiest),
+			mostAllocations, liveBytes / (1024.0 * 1024.0)), (int)panel.x + 10, (int)y + 56, 10, allocations > 0 ? ORANGE : DARKGRAY);
+}
 
 //Display world state
-void draw(PhysicsSimulation& sim)
+void draw(const RenderSnapshot& frame)
 {
-	BeginDrawing();
+	PROFILE_ZONE("draw");
 	ClearBackground(WHITE);
 
 	//// Slider variables2
 	float rectangleWidth = 400;
-	//GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 15, rectangleWidth, 20 }, "Launch Angle", 
-	//	TextFormat("%.2f", launchAngle), &launchAngle, 0, 360.0f);
-	//GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 45, rectangleWidth, 20 }, "Launch Speed", 
-	//	TextFormat("%.2f", launchSpeed), &launchSpeed, 25, 200);
+	GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 15, rectangleWidth, 20 }, "Launch Angle", 
+		TextFormat("%.2f", launch.angle), &launch.angle, 0, 360.0f);
+	GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 45, rectangleWidth, 20 }, "Launch Speed", 
+		TextFormat("%.2f", launch.speed), &launch.speed, 25, 200);
 	GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 75, rectangleWidth, 20 }, "Launch X", 
-		TextFormat("%.2f", launchPosition.x), &launchPosition.x, 0, GetScreenWidth());
+		TextFormat("%.2f", launch.position.x), &launch.position.x, 0, GetScreenWidth());
 	//GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 105, rectangleWidth, 20 }, "Launch Y", 
-	//	TextFormat("%.2f", launchPosition.y), &launchPosition.y, 0, GetScreenHeight());
+	//	TextFormat("%.2f", launch.position.y), &launch.position.y, 0, GetScreenHeight());
 	//GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 135, rectangleWidth, 20 }, "Gravity Y",
 	//	TextFormat("%.2f", sim.gravity.y), & sim.gravity.y, -20, 20);
 	//GuiSliderBar(Rectangle{ InitialWidth - rectangleWidth - 60, 165, rectangleWidth, 20 }, "Gravity x",
 	//	TextFormat("%.2f", sim.gravity.x), &sim.gravity.x, -15, 15);
 
 	//// Text for slider variables
-	//DrawText(TextFormat("Angle: %.2f", launchAngle), 10, 15, 20, BLACK);
-	//DrawText(TextFormat("Speed: %.2f", launchSpeed), 10, 45, 20, BLACK);
-	//DrawText(TextFormat("Launch Position: (%.2f, %.2f)", launchPosition.x, launchPosition.y), 10, 75, 20, BLACK);
+	//DrawText(TextFormat("Angle: %.2f", launch.angle), 10, 15, 20, BLACK);
+	//DrawText(TextFormat("Speed: %.2f", launch.speed), 10, 45, 20, BLACK);
+	//DrawText(TextFormat("Launch Position: (%.2f, %.2f)", launch.position.x, launch.position.y), 10, 75, 20, BLACK);
 	//DrawText(TextFormat("Gravity: (%.2f, %.2f)", sim.gravity.x, sim.gravity.y), 10, 105, 20, BLACK);
 
 	//// Circle representing the launch position
-	DrawCircleV(launchPosition, 10, ORANGE);
+	DrawCircleV(launch.position, 10, ORANGE);
 
 	//// Line representing the launch angle and speed
-	//Vector2 velocityVector = Vector2Rotate(Vector2UnitX, DEG2RAD * launchAngle) * launchSpeed;
-	//DrawLineV(launchPosition, launchPosition + velocityVector, RED);
+	Vector2 velocityVector = launch.Velocity();
+	DrawLineV(launch.position, launch.position + velocityVector, RED);
+
+	// Predicted path of the next launch
+	for (size_t i = 1; i < frame.previewPoints.size(); ++i)
+		DrawLineV(frame.previewPoints[i - 1], frame.previewPoints[i], LIGHTGRAY);
+	if (frame.previewHit)
+		DrawCircleLinesV(frame.previewPoints.back(), frame.launch.radius, GRAY);
 
-	for (const PhysicsBody& o : sim.objects)
+	// Between the last two steps, however long they were
+	float alpha = frame.Alpha(std::chrono::steady_clock::now());
+
+	for (const RenderBody& o : frame.bodies)
 	{
 		Color colour = o.collision ? RED : o.color;
 		if (o.colliderType == COLLIDER_TYPE_CIRCLE)
-			DrawCircleV(o.position, o.collider.circle.radius, colour);
+			DrawCircleV(frame.Position(o, alpha), o.radius, colour);
 		else if (o.colliderType == COLLIDER_TYPE_HALF_SPACE)
 		{
 			// Flip the normal to determine the direction of the half space
-			Vector2 direction = { -o.collider.halfSpace.normal.y, o.collider.halfSpace.normal.x };
+			Vector2 direction = { -o.normal.y, o.normal.x };
 			Vector2 p0 = o.position + direction * 1000.0f;
 			Vector2 p1 = o.position - direction * 1000.0f;
 
@@ -253,26 +172,25 @@ void draw(PhysicsSimulation& sim)
 			DrawLineEx(p0, p1, 5.0f,colour);
 
 			// Line to show normal
-			DrawLineEx(o.position, o.position + o.collider.halfSpace.normal * 50.0f, 5.0f, GOLD);
+			DrawLineEx(o.position, o.position + o.normal * 50.0f, 5.0f, GOLD);
 		}
 	}
 
-	Vector2 circlePos = sim.objects[2].position;
-	Vector2 halfSpacePos = sim.objects[1].position;
-	Vector2 normal = sim.objects[1].collider.halfSpace.normal;
-
-	Vector2 toCircle = circlePos - halfSpacePos;
-	float proj = Vector2DotProduct(toCircle, sim.objects[1].collider.halfSpace.normal);
-	//DrawLineEx(halfSpacePos, halfSpacePos + toCircle, 5.0f, BLUE);
-	//DrawCircleV(halfSpacePos + normal * proj, 20.0f, PINK);
+	// Outline the circle under the cursor
+	for (int i : frame.hovered)
+	{
+		const RenderBody& o = frame.bodies[i];
+		if (o.colliderType == COLLIDER_TYPE_CIRCLE)
+			DrawCircleLinesV(frame.Position(o, alpha), o.radius + 3.0f, BLACK);
+	}
 
-	EndDrawing();
+	if (showProfiler)
+		drawProfilerOverlay(frame);
 }
 
-int main()
+int main(int argc, char** argv)
 {
 	PhysicsSimulation sim;
-	PhysicsBody* entity = nullptr;
 
 	//// Describe the static circle first
 	//PhysicsBody& circle = sim.objects.back();
@@ -292,33 +210,7 @@ int main()
 	//entity->colliderType = COLLIDER_TYPE_CIRCLE;
 	//entity->color = GREEN;
 
-	// Gravity affected circle
-	// Stationary
-	sim.objects.push_back({});
-	entity = &sim.objects.back();
-	entity->position = { 350.0f, 200.0f };
-	entity->collider.circle.radius = 20.0f;
-	entity->gravityScale = 1.0f;
-	entity->colliderType = COLLIDER_TYPE_CIRCLE;
-	entity->color = GREEN;
-
-	// Stationary half-space -45 degrees
-	sim.objects.push_back({});
-	entity = &sim.objects.back();
-	entity->position = { 400.0f, 400.0f };
-	entity->gravityScale = 0.0f;
-	entity->colliderType = COLLIDER_TYPE_HALF_SPACE;
-	entity->color = PURPLE;
-	entity->collider.halfSpace.normal = Vector2Rotate(Vector2UnitX, -45.0f * DEG2RAD); // Pointing down 
-
-	// Stationary half-space 45 degrees
-	sim.objects.push_back({});
-	entity = &sim.objects.back();
-	entity->position = { 800.0f, 400.0f };
-	entity->gravityScale = 0.0f;
-	entity->colliderType = COLLIDER_TYPE_HALF_SPACE;
-	entity->color = PURPLE;
-	entity->collider.halfSpace.normal = Vector2Rotate(Vector2UnitX, 225.0f * DEG2RAD); // Pointing down 
+	BuildFunnelScene(sim);
 
 	//// Dynamic
 	//sim.objects.push_back({});
@@ -331,46 +223,157 @@ int main()
 	//PhysicsBody circleStatic, circleDynmamic;
 	//circleStatic.position = { 400.0f, 400.0f };
 
+	// Headless batch commands, no window
+	if (IsBatchCommand(argc, argv))
+		return RunBatchCommand(argc, argv, sim, launch);
+
+	// The physics step's scratch memory shows up under MEMORY_TAG_PHYSICS in raylib's memory tracker
+	ScratchArena::SetAllocator([](size_t bytes) { return MemAllocTagged((unsigned int)bytes, MEMORY_TAG_PHYSICS); },
+		[](void* memory) { MemFree(memory); });
+
+	// Launched circles that fly far off screen are dropped
+	sim.cullingEnabled = true;
+	sim.cullBounds = { -500.0f, -500.0f, InitialWidth + 1000.0f, InitialHeight + 1000.0f };
+
+	// Set before a recording snapshots the simulation, a replay brings its own
+	sim.focusBounds = { 0.0f, 0.0f, (float)InitialWidth, (float)InitialHeight };
+	sim.lodEnabled = true; // Off-screen bodies at a lower rate
+	sim.reorderEnabled = true; // Launched bodies end up all over the array otherwise
+
+	// --stats path streams the step counters, .csv for text, anything else for binary
+	// --record path saves every body at every step, read it back with --trajectory
+	// --record-input path saves the session's inputs, --replay path plays them back
+	// --integrator euler|verlet|pbd|rk4 picks how bodies move, --adaptive-step sizes steps by how fast things move,
+	// a replay brings its own settings
+	StatsLog statsLog;
+	TrajectoryRecorder recorder;
+	InputRecorder inputRecorder;
+	InputReplay replay;
+	for (int i = 1; i < argc; ++i) // Before the recordings below take their snapshot
+	{
+		if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc && !PhysicsSimulation::FindIntegrator(argv[i + 1], &sim.integrator))
+			TraceLog(LOG_WARNING, "Unknown integrator %s", argv[i + 1]);
+		if (strcmp(argv[i], "--adaptive-step") == 0)
+			sim.adaptiveTimestep.enabled = true;
+	}
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], "--stats") == 0 && !statsLog.Open(argv[i + 1], 1.0f / sim.TARGET_FPS))
+			TraceLog(LOG_WARNING, "Could not open stats log %s", argv[i + 1]);
+		if (strcmp(argv[i], "--record") == 0 && !recorder.Open(argv[i + 1], 1.0f / sim.TARGET_FPS))
+			TraceLog(LOG_WARNING, "Could not open trajectory %s", argv[i + 1]);
+		if (strcmp(argv[i], "--record-input") == 0 && !inputRecorder.Open(argv[i + 1], sim, launch, 1.0f / sim.TARGET_FPS))
+			TraceLog(LOG_WARNING, "Could not open input recording %s", argv[i + 1]);
+		if (strcmp(argv[i], "--replay") == 0 && !replay.Open(argv[i + 1], sim, launch))
+			TraceLog(LOG_WARNING, "Could not open replay %s", argv[i + 1]);
+	}
+
+	// Trade quality for time when steps run long, except when inputs are recorded or replayed:
+	// the budget follows the wall clock and the replay has to step exactly like the recording
+	sim.budget.enabled = !inputRecorder.IsOpen() && !replay.IsOpen();
+
+	// From here on the simulation belongs to its thread, the loop below only sees snapshots
+	LaunchControls simLaunch = launch;
+	SimulationThread simThread(sim, simLaunch);
+	simThread.statsLog = &statsLog;
+	simThread.trajectoryRecorder = &recorder;
+	simThread.inputRecorder = &inputRecorder;
+	simThread.replay = replay.IsOpen() ? &replay : nullptr;
+
 	InitWindow(InitialWidth, InitialHeight, "Angry Birds");
 	SetTargetFPS(sim.TARGET_FPS);
+	simThread.Start();
 
-	while (!WindowShouldClose()) // Loops TARGET_FPS times per second
+	Vector2 lastPointer = { -1.0f, -1.0f };
+	while (!WindowShouldClose()) // Loops TARGET_FPS times per second, the simulation steps on its own
 	{
 		//entity->position = GetMousePosition();
 
-		if (IsKeyPressed(KEY_SPACE))
+		const RenderSnapshot& frame = simThread.Latest();
+
+		// Launcher input comes from the replay until it runs out, then from the keyboard
+		if (frame.replaying)
+			launch = frame.launch;
+		else
 		{
-			PhysicsBody b;
-			b.position = launchPosition;
-			b.velocity = Vector2Rotate(Vector2UnitX, DEG2RAD * 90) * launchSpeed;
-			b.colliderType = COLLIDER_TYPE_CIRCLE;
-			b.collider.circle.radius = 20.0f;
-			b.color = GREEN;
-			
-			sim.objects.push_back(b);
+			for (int i = 0; i < LAUNCH_KEY_COUNT; ++i)
+				if (IsKeyPressed(LAUNCH_KEYS[i]))
+				{
+					SimCommand command;
+					command.key = LAUNCH_KEYS[i];
+					simThread.Send(command);
+					ApplyLaunchPreset(launch, LAUNCH_KEYS[i]);
+				}
 		}
 
-		if (IsKeyPressed(KEY_U))
-			launchAngle = 0;
-		else if (IsKeyPressed(KEY_I))
-			launchAngle = 45;
-		else if (IsKeyPressed(KEY_O))
-			launchAngle = 60;
-		else if (IsKeyPressed(KEY_P))
-			launchAngle = 90;
-		else if (IsKeyPressed(KEY_J))
-			launchAngle = 315;
-		else if (IsKeyPressed(KEY_K))
-			launchAngle = 300;
-		else if (IsKeyPressed(KEY_L))
-			launchAngle = 270;
-
-		sim.updateTime();
-		sim.UpdateObjectPositions();
-		sim.CheckCollision();
-		draw(sim);
+		Vector2 pointer = GetMousePosition();
+		if (!Vector2Equals(pointer, lastPointer))
+		{
+			SimCommand command;
+			command.type = SIM_COMMAND_POINTER;
+			command.point = pointer;
+			if (simThread.Send(command))
+				lastPointer = pointer;
+		}
+
+		if (IsKeyPressed(KEY_F1))
+		{
+			showProfiler = !showProfiler;
+			Profiler::SetEnabled(showProfiler || Profiler::IsCapturing());
+		}
+		if (IsKeyPressed(KEY_F2))
+		{
+			if (Profiler::IsCapturing())
+			{
+				Profiler::EndCapture("profile_trace.json");
+				Profiler::SetEnabled(showProfiler);
+			}
+			else
+			{
+				Profiler::SetEnabled(true);
+				Profiler::BeginCapture();
+			}
+		}
+
+		// The sliders change the launcher while drawing, lock them during a replay and pass changes on otherwise
+		if (frame.replaying)
+			GuiLock();
+		else
+			GuiUnlock();
+		LaunchControls beforeDraw = launch;
+
+		BeginDrawing();
+		draw(frame);
+
+		const SimCommandType sliders[] = { SIM_COMMAND_LAUNCH_ANGLE, SIM_COMMAND_LAUNCH_SPEED, SIM_COMMAND_LAUNCH_X };
+		const float before[] = { beforeDraw.angle, beforeDraw.speed, beforeDraw.position.x };
+		const float after[] = { launch.angle, launch.speed, launch.position.x };
+		for (int i = 0; i < 3; ++i)
+			if (after[i] != before[i])
+			{
+				SimCommand command;
+				command.type = sliders[i];
+				command.value = after[i];
+				simThread.Send(command);
+			}
+
+		// Nothing moves and every command this frame sent has been seen: EndDrawing() blocks until there's input.
+		// Input sends a command, which wakes the simulation and keeps frames coming until it's idle again.
+		if (simThread.IsIdle(frame))
+			EnableEventWaiting();
+		else
+			DisableEventWaiting();
+		{
+			PROFILE_ZONE("EndDrawing");
+			EndDrawing();
+		}
+
+		Profiler::EndFrame();
 	}
 
+	simThread.Stop();
+	inputRecorder.Close(sim);
+	sim.ReleaseScratch(); // CloseWindow() reports whatever is still allocated as leaked
 	CloseWindow();
 	return 0;
-}
\ No newline at end of file
+}
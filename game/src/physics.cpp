@@ -0,0 +1,1745 @@
+#include "physics.h"
+#include "physics_kernels.h"
+#include "profiler.h"
+#include <chrono>
+#include <cstring>
+
+// Measures the time between laps, costs nothing when disabled
+class PhaseClock
+{
+	bool enabled;
+	std::chrono::steady_clock::time_point last;
+
+public:
+	explicit PhaseClock(bool enabled) : enabled(enabled)
+	{
+		if (enabled)
+			last = std::chrono::steady_clock::now();
+	}
+
+	double Lap()
+	{
+		if (!enabled)
+			return 0.0;
+		auto now = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(now - last).count();
+		last = now;
+		return ms;
+	}
+};
+
+void PhysicsSimulation::Step(float stepDt)
+{
+	std::chrono::steady_clock::time_point stepStart;
+	if (budget.enabled)
+		stepStart = std::chrono::steady_clock::now();
+
+	time += stepDt;
+	stepCount++;
+
+	PhysicsStepStats& stats = lastStats;
+	PhysicsStepStats previous = stats;
+	stats = PhysicsStepStats();
+	stats.step = stepCount;
+	stats.stepDt = stepDt;
+	stats.time = time;
+	stats.bodiesSpawned = objects.size() > lastBodyCount ? (int)(objects.size() - lastBodyCount) : 0;
+
+	// The last step's transient data goes, contacts and predictions with it
+	contacts.Release();
+	predictedPositions.Release();
+	predictedInverseDt.Release();
+	forces.Release();
+	scratch.Reset();
+
+	SyncHandles();
+	if (reorderEnabled && reorderInterval > 0 && stepCount % reorderInterval == 0)
+	{
+		PROFILE_ZONE("reorder");
+		stats.bodiesReordered = SortNextWindow();
+	}
+
+	// What the budget lets this step do
+	bool fullSolver = !IsDegraded(BUDGET_DEGRADE_SOLVER);
+	stepSubsteps = fullSolver ? std::max(substeps, 1) : 1;
+	int iterations = fullSolver ? std::max(solverIterations, 1) : 1;
+	bool deferredWorkDue = !IsDegraded(BUDGET_DEGRADE_DEFERRED_WORK) || stepCount - lastDeferredWorkStep >= (uint64_t)deferredWorkInterval;
+
+	// Same as UpdateObjectPositions() + CheckCollision() per substep, split up so each phase can be timed
+	dt = stepDt / stepSubsteps;
+	lastTimings = PhysicsStepTimings();
+	PhaseClock clock(recordTimings);
+	for (substep = 0; substep < stepSubsteps; ++substep)
+	{
+		{
+			PROFILE_ZONE("integrate");
+			UpdateObjectPositions();
+			if (substep == 0 && deferredWorkDue)
+				stats.bodiesCulled = CullBodies();
+		}
+		lastTimings.integrateMs += clock.Lap();
+
+		{
+			PROFILE_ZONE("broadphase");
+			UpdateBroadphase();
+		}
+		lastTimings.broadphaseMs += clock.Lap();
+
+		{
+			PROFILE_ZONE("narrowphase");
+			FindContacts();
+		}
+		lastTimings.narrowphaseMs += clock.Lap();
+
+		{
+			PROFILE_ZONE("resolve");
+			int resolved = ResolveContacts(iterations);
+			stats.contactsResolved += resolved;
+			if (resolved > 0)
+				UpdateBroadphase();
+			if (integrator == INTEGRATOR_POSITION_BASED)
+				UpdatePositionBasedVelocities();
+		}
+		lastTimings.resolveMs += clock.Lap();
+	}
+	substep = 0;
+	stepSubsteps = 1;
+	dt = stepDt;
+
+	if (deferredWorkDue)
+	{
+		PROFILE_ZONE("sleep");
+		UpdateSleeping((stepCount - lastDeferredWorkStep) * stepDt);
+		lastDeferredWorkStep = stepCount;
+	}
+	else
+	{
+		// Counted by the sleep check, carry the last ones until it runs again
+		stats.activeBodies = previous.activeBodies;
+		stats.sleepingBodies = previous.sleepingBodies;
+		stats.staticBodies = previous.staticBodies;
+	}
+
+	stats.broadphaseEfficiency = stats.narrowphaseTests > 0 ? (float)stats.narrowphaseHits / stats.narrowphaseTests : 0.0f;
+	stats.scratchBytes = (int)(scratch.Used() + broadphase.storage.Used());
+	lastBodyCount = objects.size();
+
+	if (budget.enabled)
+		UpdateBudget(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - stepStart).count());
+	else
+	{
+		qualityTier = 0;
+		stepCostMs = 0.0f;
+	}
+	stats.qualityTier = qualityTier;
+	stats.stepCostMs = stepCostMs;
+}
+
+float PhysicsSimulation::NextTimeStep(float fixedDt) const
+{
+	if (!adaptiveTimestep.enabled)
+		return fixedDt;
+
+	// Speed from how far bodies really got last step: resolution leaves the velocity of resting bodies growing,
+	// taken at face value a settled pile would hold the step at minDt forever. New bodies only have their velocity.
+	float maxSpeedSqr = 0.0f;
+	float minRadius = 0.0f;
+	float lastDt = dt > 0.0f ? dt : fixedDt;
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		const PhysicsBody& o = objects[i];
+		if (o.colliderType != COLLIDER_TYPE_CIRCLE || o.sleeping || o.IsStatic())
+			continue;
+
+		if (minRadius == 0.0f || o.radius < minRadius)
+			minRadius = o.radius;
+
+		float speedSqr = i < (int)stepStartPositions.size() ?
+			Vector2DistanceSqr(o.position, stepStartPositions[i]) / (lastDt * lastDt) : Vector2LengthSqr(o.velocity);
+		maxSpeedSqr = std::max(maxSpeedSqr, speedSqr);
+	}
+
+	// What gravity can add over the longest step, or a body starting to fall would get the longest step
+	float speed = sqrtf(maxSpeedSqr) + Vector2Length(gravity) * adaptiveTimestep.maxDt;
+	if (minRadius == 0.0f || speed == 0.0f)
+		return adaptiveTimestep.maxDt;
+	return std::min(std::max(adaptiveTimestep.cfl * minRadius / speed, adaptiveTimestep.minDt), adaptiveTimestep.maxDt);
+}
+
+void PhysicsSimulation::ReleaseScratch()
+{
+	contacts.Release();
+	predictedPositions.Release();
+	predictedInverseDt.Release();
+	forces.Release();
+	scratch.Release();
+}
+
+void PhysicsSimulation::UpdateBudget(float costMs)
+{
+	// Smoothed, a single slow step shouldn't change the tier
+	stepCostMs = stepCostMs > 0.0f ? stepCostMs + (costMs - stepCostMs) * 0.1f : costMs;
+
+	stepsSinceTierChange++;
+	if (stepCostMs < budget.budgetMs * budget.restoreBelow)
+		stepsUnderBudget++;
+	else
+		stepsUnderBudget = 0;
+
+	if (stepsSinceTierChange < budget.settleSteps)
+		return;
+
+	int maxTier = std::min(std::max(budget.orderCount, 0), (int)BUDGET_DEGRADATION_COUNT);
+	int tier = qualityTier;
+	if (stepCostMs > budget.budgetMs * budget.degradeAbove && qualityTier < maxTier)
+		tier++;
+	else if (stepsUnderBudget >= budget.settleSteps && qualityTier > 0)
+		tier--;
+
+	if (tier != qualityTier)
+	{
+		qualityTier = tier;
+		stepsSinceTierChange = 0;
+		stepsUnderBudget = 0;
+	}
+}
+
+bool PhysicsSimulation::IsDegraded(BudgetDegradation degradation) const
+{
+	for (int i = 0; i < qualityTier; ++i)
+		if (budget.order[i] == degradation)
+			return true;
+	return false;
+}
+
+const char* PhysicsSimulation::DegradationName(BudgetDegradation degradation)
+{
+	switch (degradation)
+	{
+	case BUDGET_DEGRADE_SOLVER: return "solver";
+	case BUDGET_DEGRADE_FAR_BODIES: return "far bodies";
+	case BUDGET_DEGRADE_DEFERRED_WORK: return "deferred work";
+	default: return "?";
+	}
+}
+
+// Squared distance from p to the nearest point of bounds, 0 inside
+static float DistanceOutsideSqr(Vector2 p, Rectangle bounds)
+{
+	float dx = std::max(std::max(bounds.x - p.x, p.x - (bounds.x + bounds.width)), 0.0f);
+	float dy = std::max(std::max(bounds.y - p.y, p.y - (bounds.y + bounds.height)), 0.0f);
+	return dx * dx + dy * dy;
+}
+
+int PhysicsSimulation::LodLevel(int i, bool farDegraded) const
+{
+	const PhysicsBody& o = objects[i];
+	if (o.IsStatic() || timers[i].lodHoldTime > 0.0f)
+		return 0;
+
+	float half = lodHalfRateDistance * lodHalfRateDistance;
+	float quarter = lodQuarterRateDistance * lodQuarterRateDistance;
+	auto level = [&](float distanceSqr) { return distanceSqr > quarter ? 2 : distanceSqr > half ? 1 : 0; };
+
+	// Judged where it is now and where it will be by its next turn, so it's back at full rate before it gets close
+	float distance = DistanceOutsideSqr(o.position, focusBounds);
+	int lod = level(distance);
+	if (lod > 0)
+	{
+		float lookahead = dt * stepSubsteps * (1 << lod);
+		lod = std::min(lod, level(DistanceOutsideSqr(o.position + o.velocity * lookahead, focusBounds)));
+	}
+
+	if (distance > 0.0f && farDegraded)
+		lod++;
+	return lod;
+}
+
+void PhysicsSimulation::UpdateObjectPositions()
+{
+	bool farDegraded = IsDegraded(BUDGET_DEGRADE_FAR_BODIES);
+	bool lod = lodEnabled || farDegraded;
+	bool positionBased = integrator == INTEGRATOR_POSITION_BASED;
+
+	if (substep == 0)
+	{
+		SyncHandles(); // Timers for bodies appended outside of a step
+		stepStartPositions.resize(objects.size());
+	}
+	if (positionBased)
+	{
+		predictedPositions.Resize(scratch, objects.size());
+		predictedInverseDt.Resize(scratch, objects.size());
+		std::fill(predictedInverseDt.begin(), predictedInverseDt.end(), 0.0f);
+	}
+	if (forceGenerators.empty())
+		forces.ax.Clear(); // Gravity alone is cheaper to work out as each body is integrated
+	else
+		AccumulateForces();
+
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		PhysicsBody& o = objects[i];
+		PhysicsBodyTimers& t = timers[i];
+		if (substep == 0)
+		{
+			stepStartPositions[i] = o.position;
+
+			// The rate holds for the whole step
+			t.lodHoldTime = std::max(t.lodHoldTime - dt * stepSubsteps, 0.0f);
+			o.lodLevel = lod && !o.sleeping ? LodLevel(i, farDegraded) : 0;
+			if (o.lodLevel > 0)
+				lastStats.reducedRateBodies++;
+		}
+
+		// Reset every loop
+		bool ballistic = !o.collision; // No contact last time
+		o.collision = false;
+		o.deferred = false;
+
+		if (o.sleeping)
+			continue;
+
+		// Bodies on a reduced rate take turns, staggered by index. Intervals are powers of two, a mask does for the modulo
+		if (((stepCount + i) & ((1u << o.lodLevel) - 1)) != 0)
+		{
+			o.deferred = true;
+			t.lodDt += dt;
+			continue;
+		}
+
+		float bodyDt = dt + t.lodDt;
+		t.lodDt = 0.0f;
+
+		Integrate(i, bodyDt, ballistic);
+		if (positionBased)
+		{
+			predictedPositions[i] = o.position;
+			predictedInverseDt[i] = 1.0f / bodyDt;
+		}
+	}
+}
+
+void PhysicsSimulation::Integrate(int i, float h, bool ballistic)
+{
+	PhysicsBody& o = objects[i];
+	switch (integrator)
+	{
+	case INTEGRATOR_VELOCITY_VERLET:
+	case INTEGRATOR_POSITION_BASED:
+	{
+		Vector2 acc = StartAcceleration(i);
+		o.position += o.velocity * h + acc * (0.5f * h * h);
+		Vector2 nextAcc = Acceleration(i, o.position, o.velocity + acc * h);
+		o.velocity += (acc + nextAcc) * (0.5f * h);
+		break;
+	}
+
+	case INTEGRATOR_RK4:
+		if (ballistic)
+		{
+			Vector2 x = o.position, v = o.velocity;
+			Vector2 a1 = StartAcceleration(i);
+			Vector2 v2 = v + a1 * (0.5f * h);
+			Vector2 a2 = Acceleration(i, x + v * (0.5f * h), v2);
+			Vector2 v3 = v + a2 * (0.5f * h);
+			Vector2 a3 = Acceleration(i, x + v2 * (0.5f * h), v3);
+			Vector2 v4 = v + a3 * h;
+			Vector2 a4 = Acceleration(i, x + v3 * h, v4);
+
+			o.position += (v + (v2 + v3) * 2.0f + v4) * (h / 6.0f);
+			o.velocity += (a1 + (a2 + a3) * 2.0f + a4) * (h / 6.0f);
+			break;
+		}
+		// Contacts only correct positions to first order, higher order buys nothing there
+		IntegrateEuler(i, h);
+		break;
+
+	default:
+		IntegrateEuler(i, h);
+		break;
+	}
+}
+
+void PhysicsSimulation::IntegrateEuler(int i, float h)
+{
+	typedef PhysicsKernels<float>::Vector Vector;
+	PhysicsBody& o = objects[i];
+	Vector position = Vector::From(o.position), velocity = Vector::From(o.velocity);
+	PhysicsKernels<float>::Integrate(position, velocity, Vector::From(StartAcceleration(i)), h);
+	o.position = position.ToVector2();
+	o.velocity = velocity.ToVector2();
+}
+
+Vector2 PhysicsSimulation::StartAcceleration(int i) const
+{
+	if (i < (int)forces.ax.Size())
+		return { forces.ax[i], forces.ay[i] };
+	return Acceleration(i, objects[i].position, objects[i].velocity);
+}
+
+// Groups of the generators that act on body o
+static uint32_t ForceGroupsOf(const PhysicsBody& o)
+{
+	return o.IsStatic() ? 0 : o.forceGroups;
+}
+
+// 1 if the groups have a bit in common, else 0. Arithmetic instead of a comparison, which GCC turns into control flow
+// the passes then don't vectorize over. Body groups are 8 bits, so the difference never reaches the sign bit.
+static float SharesGroup(uint32_t bodyGroups, uint32_t generatorGroups)
+{
+	return (float)(int)((((bodyGroups & generatorGroups) + 0xFFFFFFFFu) >> 31) ^ 1u);
+}
+
+Vector2 PhysicsSimulation::Acceleration(int i, Vector2 position, Vector2 velocity) const
+{
+	const PhysicsBody& o = objects[i];
+	Vector2 acc = gravity * o.GravityScale();
+	if (forceGenerators.empty())
+		return acc;
+
+	// The same operations in the same order as AccumulateForce() below
+	float scale = o.GravityScale(), drag = i < (int)details.size() ? details[i].drag : 1.0f;
+	uint32_t groups = ForceGroupsOf(o);
+	for (const ForceGenerator& g : forceGenerators)
+	{
+		if (g.groups == 0)
+			continue;
+		Vector2 a = ForceAcceleration(g, position, velocity, scale, drag);
+		float on = SharesGroup(groups, g.groups);
+		acc.x += a.x * on;
+		acc.y += a.y * on;
+	}
+	return acc;
+}
+
+void PhysicsSimulation::ForceArrays::Release()
+{
+	x.Release();
+	y.Release();
+	vx.Release();
+	vy.Release();
+	gravityScale.Release();
+	drag.Release();
+	groups.Release();
+	ax.Release();
+	ay.Release();
+}
+
+// Body state as the force passes read it
+struct ForcePassInputs
+{
+	const float* x;
+	const float* y;
+	const float* vx;
+	const float* vy;
+	const float* gravityScale;
+	const float* drag;
+	const uint32_t* groups;
+	int count;
+};
+
+// One generator over every body, the type fixed at compile time. Bodies it doesn't act on add 0,
+// a select instead of a branch, which keeps the loop vectorizable.
+template <ForceGeneratorType Type>
+static void AccumulateForce(const ForceGenerator& generator, const ForcePassInputs& in, float* ax, float* ay)
+{
+	// Copies the stores can't alias, or they're reloaded for every body and the loop isn't vectorized
+	const ForceGenerator g = generator;
+	const uint32_t groups = generator.groups;
+	for (int i = 0; i < in.count; ++i)
+	{
+		Vector2 a = ForceAcceleration<Type>(g, { in.x[i], in.y[i] }, { in.vx[i], in.vy[i] }, in.gravityScale[i], in.drag[i]);
+		float on = SharesGroup(in.groups[i], groups);
+		ax[i] += a.x * on;
+		ay[i] += a.y * on;
+	}
+}
+
+void PhysicsSimulation::AccumulateForces()
+{
+	SyncHandles(); // The drag passes read details
+
+	int count = (int)objects.size();
+	ForceArrays& f = forces;
+	for (ScratchArray<float>* array : { &f.x, &f.y, &f.vx, &f.vy, &f.gravityScale, &f.drag, &f.ax, &f.ay })
+		array->Resize(scratch, count);
+	f.groups.Resize(scratch, count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const PhysicsBody& o = objects[i];
+		float scale = o.GravityScale();
+		f.x[i] = o.position.x;
+		f.y[i] = o.position.y;
+		f.vx[i] = o.velocity.x;
+		f.vy[i] = o.velocity.y;
+		f.gravityScale[i] = scale;
+		f.drag[i] = details[i].drag;
+		f.groups[i] = ForceGroupsOf(o);
+		Vector2 acc = gravity * scale;
+		f.ax[i] = acc.x;
+		f.ay[i] = acc.y;
+	}
+
+	ForcePassInputs in = { f.x.Data(), f.y.Data(), f.vx.Data(), f.vy.Data(), f.gravityScale.Data(), f.drag.Data(), f.groups.Data(), count };
+	float* ax = f.ax.Data();
+	float* ay = f.ay.Data();
+	for (const ForceGenerator& g : forceGenerators)
+	{
+		switch (g.groups != 0 ? g.type : FORCE_GENERATOR_COUNT)
+		{
+		case FORCE_UNIFORM: AccumulateForce<FORCE_UNIFORM>(g, in, ax, ay); break;
+		case FORCE_LINEAR_DRAG: AccumulateForce<FORCE_LINEAR_DRAG>(g, in, ax, ay); break;
+		case FORCE_QUADRATIC_DRAG: AccumulateForce<FORCE_QUADRATIC_DRAG>(g, in, ax, ay); break;
+		case FORCE_WIND: AccumulateForce<FORCE_WIND>(g, in, ax, ay); break;
+		case FORCE_ATTRACTOR: AccumulateForce<FORCE_ATTRACTOR>(g, in, ax, ay); break;
+		case FORCE_SPRING: AccumulateForce<FORCE_SPRING>(g, in, ax, ay); break;
+		default: break; // Switched off
+		}
+	}
+}
+
+void PhysicsSimulation::UpdatePositionBasedVelocities()
+{
+	// Whatever the contacts took off the predicted move comes off the velocity too, bodies resting on something stop
+	int count = std::min((int)objects.size(), (int)predictedInverseDt.Size());
+	for (int i = 0; i < count; ++i)
+		if (predictedInverseDt[i] > 0.0f)
+			objects[i].velocity += (objects[i].position - predictedPositions[i]) * predictedInverseDt[i];
+}
+
+const char* PhysicsSimulation::IntegratorName(IntegratorType type)
+{
+	switch (type)
+	{
+	case INTEGRATOR_SEMI_IMPLICIT_EULER: return "euler";
+	case INTEGRATOR_VELOCITY_VERLET: return "verlet";
+	case INTEGRATOR_POSITION_BASED: return "pbd";
+	case INTEGRATOR_RK4: return "rk4";
+	default: return "?";
+	}
+}
+
+bool PhysicsSimulation::FindIntegrator(const char* name, IntegratorType* type)
+{
+	for (int i = 0; i < INTEGRATOR_COUNT; ++i)
+	{
+		if (strcmp(name, IntegratorName((IntegratorType)i)) == 0)
+		{
+			*type = (IntegratorType)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint32_t HandleSlotOf(BodyHandle handle) { return handle & 0xFFFFFFu; }
+static uint8_t HandleGeneration(BodyHandle handle) { return (uint8_t)(handle >> 24); }
+
+template <typename Remove>
+int PhysicsSimulation::CompactBodies(Remove remove)
+{
+	SyncHandles();
+
+	// Compact in place, keeping the order of the survivors
+	int kept = 0;
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		BodyHandle handle = details[i].handle;
+		HandleSlot& slot = handleSlots[HandleSlotOf(handle)];
+		if (remove(i))
+		{
+			// A new generation, so the old handle no longer finds whoever gets the slot next
+			slot.index = -1;
+			slot.generation++;
+			freeHandleSlots.push_back(HandleSlotOf(handle));
+			continue;
+		}
+
+		slot.index = kept;
+		objects[kept] = objects[i];
+		timers[kept] = timers[i];
+		details[kept] = details[i];
+		if (i < (int)stepStartPositions.size())
+			stepStartPositions[kept] = stepStartPositions[i];
+		if (i < (int)predictedInverseDt.Size())
+		{
+			predictedPositions[kept] = predictedPositions[i];
+			predictedInverseDt[kept] = predictedInverseDt[i];
+		}
+		kept++;
+	}
+
+	int removed = (int)objects.size() - kept;
+	objects.resize(kept);
+	timers.resize(kept);
+	details.resize(kept);
+	handledBodies = kept;
+	if (stepStartPositions.size() > (size_t)kept)
+		stepStartPositions.resize(kept);
+	if (predictedInverseDt.Size() > (size_t)kept)
+	{
+		predictedPositions.Resize(scratch, kept);
+		predictedInverseDt.Resize(scratch, kept);
+	}
+	return removed;
+}
+
+int PhysicsSimulation::CullBodies()
+{
+	if (!cullingEnabled)
+		return 0;
+
+	return CompactBodies([&](int i)
+	{
+		const PhysicsBody& o = objects[i];
+		bool outside = o.position.x < cullBounds.x || o.position.x > cullBounds.x + cullBounds.width ||
+			o.position.y < cullBounds.y || o.position.y > cullBounds.y + cullBounds.height;
+		return outside && o.colliderType == COLLIDER_TYPE_CIRCLE && !o.IsStatic();
+	});
+}
+
+int PhysicsSimulation::RemoveBodies(const int* indices, int count)
+{
+	int next = 0;
+	int removed = CompactBodies([&](int i)
+	{
+		if (next < count && indices[next] == i)
+		{
+			next++;
+			return true;
+		}
+		return false;
+	});
+
+	// Called between steps, the grid and the contacts still hold the old indices and queries read them
+	if (removed > 0)
+	{
+		contacts.Clear();
+		UpdateBroadphase();
+	}
+	return removed;
+}
+
+PhysicsBodyDef PhysicsSimulation::BodyDef(int index) const
+{
+	const PhysicsBody& o = objects[index];
+	PhysicsBodyDef def;
+	def.position = o.position;
+	def.velocity = o.velocity;
+	def.gravityScale = o.GravityScale();
+	def.forceGroups = o.forceGroups;
+	def.colliderType = (ColliderType)o.colliderType;
+	if (index < (int)details.size())
+	{
+		def.color = details[index].color;
+		def.drag = details[index].drag;
+		if (o.colliderType == COLLIDER_TYPE_HALF_SPACE)
+			def.collider.halfSpace.normal = details[index].normal;
+	}
+	if (o.colliderType == COLLIDER_TYPE_CIRCLE)
+		def.collider.circle.radius = o.radius;
+	return def;
+}
+
+void PhysicsSimulation::ShiftOrigin(Vector2 offset)
+{
+	for (PhysicsBody& o : objects)
+		o.position -= offset;
+	for (Vector2& p : stepStartPositions)
+		p -= offset;
+	focusBounds.x -= offset.x;
+	focusBounds.y -= offset.y;
+	cullBounds.x -= offset.x;
+	cullBounds.y -= offset.y;
+
+	// The grid is in world cells, queries would look in the wrong ones
+	UpdateBroadphase();
+}
+
+// Interleaves the low 16 bits of v with zeros
+static uint32_t SpreadBits(uint32_t v)
+{
+	v &= 0xFFFFu;
+	v = (v | (v << 8)) & 0x00FF00FFu;
+	v = (v | (v << 4)) & 0x0F0F0F0Fu;
+	v = (v | (v << 2)) & 0x33333333u;
+	v = (v | (v << 1)) & 0x55555555u;
+	return v;
+}
+
+// Z-order position of the cell p falls into, the world is 65536 cells across around the origin
+static uint32_t MortonKey(Vector2 p, float inverseCellSize)
+{
+	auto cell = [&](float v) { return (uint32_t)std::min(std::max(std::floor(v * inverseCellSize) + 32768.0f, 0.0f), 65535.0f); };
+	return SpreadBits(cell(p.x)) | SpreadBits(cell(p.y)) << 1;
+}
+
+int PhysicsSimulation::ReorderBodies()
+{
+	SyncHandles();
+	int moved = SortBodies(0, (int)objects.size());
+
+	// Same as RemoveBodies(), between steps the grid and the contacts have to follow the bodies
+	if (moved > 0)
+	{
+		contacts.Clear();
+		UpdateBroadphase();
+	}
+	return moved;
+}
+
+int PhysicsSimulation::SortBodies(int begin, int end)
+{
+	int n = end - begin;
+
+	// Also called between steps, the scratch it takes is given back at the end
+	ScratchArena::Mark mark = scratch.GetMark();
+
+	// Morton key above the index, so sorting the keys orders by position and keeps ties in index order.
+	// Half-spaces sort first, the grid doesn't hold them anyway.
+	uint64_t* order = scratch.Allocate<uint64_t>(n);
+	int descents = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		const PhysicsBody& o = objects[begin + i];
+		uint64_t key = o.colliderType == COLLIDER_TYPE_CIRCLE ? MortonKey(o.position, broadphase.inverseCellSize) : 0;
+		order[i] = key << 32 | (uint32_t)(begin + i);
+		if (i > 0 && order[i] < order[i - 1])
+			descents++;
+	}
+	if (descents == 0)
+	{
+		scratch.Rewind(mark);
+		return 0;
+	}
+
+	// Bodies drift little between two reorders, an insertion sort over a nearly sorted array only touches what drifted.
+	// Anything more shuffled (new bodies, the first pass) gets a full sort of the range.
+	if (descents <= n / 64)
+	{
+		for (int i = 1; i < n; ++i)
+		{
+			uint64_t body = order[i];
+			int j = i;
+			for (; j > 0 && body < order[j - 1]; --j)
+				order[j] = order[j - 1];
+			order[j] = body;
+		}
+	}
+	else
+		std::sort(order, order + n);
+	auto source = [&](int i) { return (int)(uint32_t)order[i - begin]; };
+
+	// Only the range that changed is moved
+	int first = begin, last = end;
+	while (first < last && source(first) == first)
+		first++;
+	while (last > first && source(last - 1) == last - 1)
+		last--;
+
+	int moved = 0;
+	for (int i = first; i < last; ++i)
+		moved += source(i) != i;
+
+	// Each array goes through the scratch on its own, only one of them needs the space at a time
+	auto permute = [&](auto& items)
+	{
+		typedef typename std::decay<decltype(items[0])>::type Item;
+		ScratchArena::Mark start = scratch.GetMark();
+		Item* permuted = scratch.Allocate<Item>(last - first);
+		for (int i = first; i < last; ++i)
+			permuted[i - first] = items[source(i)];
+		std::copy(permuted, permuted + (last - first), items.begin() + first);
+		scratch.Rewind(start);
+	};
+	permute(objects);
+	permute(timers);
+	permute(details);
+
+	// Keep drawing between steps and the adaptive timestep lined up with the bodies
+	if (stepStartPositions.size() == objects.size())
+		permute(stepStartPositions);
+
+	UpdateHandleIndices(first, last);
+	scratch.Rewind(mark);
+	return moved;
+}
+
+int PhysicsSimulation::SortNextWindow()
+{
+	int n = (int)objects.size();
+	int window = reorderWindow > 0 ? std::min(reorderWindow, n) : n;
+	if (window < 2)
+		return 0;
+
+	// Windows overlap by half, so a body can keep moving across them from one pass to the next. The passes sweep
+	// back and forth, a body far from where it belongs is carried all the way by the first sweep its way.
+	int begin = std::min(std::max(reorderCursor, 0), n - window);
+	int moved = SortBodies(begin, begin + window);
+	if (reorderBackward ? begin == 0 : begin + window >= n)
+		reorderBackward = !reorderBackward;
+	reorderCursor = reorderBackward ? begin - window / 2 : begin + window / 2;
+	return moved;
+}
+
+BodyHandle PhysicsSimulation::AllocateHandle(int index)
+{
+	uint32_t slot;
+	if (!freeHandleSlots.empty())
+	{
+		slot = freeHandleSlots.back();
+		freeHandleSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)handleSlots.size();
+		handleSlots.push_back({ -1, 0 });
+	}
+
+	handleSlots[slot].index = index;
+	return (BodyHandle)handleSlots[slot].generation << 24 | slot;
+}
+
+void PhysicsSimulation::SyncHandles()
+{
+	// Shrunk behind our back, objects was replaced
+	if (handledBodies > objects.size())
+	{
+		RebuildHandles();
+		return;
+	}
+
+	timers.resize(objects.size());
+	details.resize(objects.size());
+	for (size_t i = handledBodies; i < objects.size(); ++i)
+		details[i].handle = AllocateHandle((int)i);
+	handledBodies = objects.size();
+}
+
+void PhysicsSimulation::RebuildHandles()
+{
+	for (HandleSlot& slot : handleSlots)
+		slot.index = -1;
+	timers.resize(objects.size());
+	details.resize(objects.size());
+
+	// Bodies keep the handles they carry where those make sense, the rest get new ones
+	size_t maxSlots = objects.size() * 2 + 1024; // Anything past this is garbage, not a handle of ours
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		BodyHandle handle = details[i].handle;
+		uint32_t slot = HandleSlotOf(handle);
+		if (handle == BODY_HANDLE_NONE || slot >= maxSlots)
+			continue;
+
+		if (slot >= handleSlots.size())
+			handleSlots.resize(slot + 1, { -1, 0 });
+		if (handleSlots[slot].index == -1)
+			handleSlots[slot] = { i, HandleGeneration(handle) };
+	}
+
+	freeHandleSlots.clear();
+	for (uint32_t slot = (uint32_t)handleSlots.size(); slot-- > 0;)
+		if (handleSlots[slot].index == -1)
+			freeHandleSlots.push_back(slot);
+
+	for (int i = 0; i < (int)objects.size(); ++i)
+		if (IndexOf(details[i].handle) != i)
+			details[i].handle = AllocateHandle(i);
+	handledBodies = objects.size();
+}
+
+// Like RebuildHandles(), but with the generations and free list the snapshot saved, so the bodies added
+// after a restore get the same handles as they did after the save
+void PhysicsSimulation::RestoreHandles(const unsigned char* generations, uint32_t slotCount, const unsigned char* freeSlots, uint32_t freeCount)
+{
+	handleSlots.resize(slotCount);
+	for (uint32_t slot = 0; slot < slotCount; ++slot)
+		handleSlots[slot] = { -1, generations[slot] };
+
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		BodyHandle handle = details[i].handle;
+		uint32_t slot = HandleSlotOf(handle);
+		if (handle != BODY_HANDLE_NONE && slot < slotCount && handleSlots[slot].generation == HandleGeneration(handle) &&
+			handleSlots[slot].index == -1)
+			handleSlots[slot].index = i;
+	}
+
+	// Unaligned in the buffer. Slots that turn out to be in use are left out, a damaged list can't hand one out twice.
+	freeHandleSlots.clear();
+	for (uint32_t k = 0; k < freeCount; ++k)
+	{
+		uint32_t slot;
+		memcpy(&slot, freeSlots + k * sizeof(uint32_t), sizeof(slot));
+		if (slot < slotCount && handleSlots[slot].index == -1)
+			freeHandleSlots.push_back(slot);
+	}
+
+	// Bodies appended after the last step were saved without a handle, they get theirs in order like SyncHandles() would
+	for (int i = 0; i < (int)objects.size(); ++i)
+		if (IndexOf(details[i].handle) != i)
+			details[i].handle = AllocateHandle(i);
+	handledBodies = objects.size();
+}
+
+void PhysicsSimulation::UpdateHandleIndices(int first, int last)
+{
+	for (int i = first; i < last; ++i)
+		handleSlots[HandleSlotOf(details[i].handle)].index = i;
+}
+
+BodyHandle PhysicsSimulation::Handle(int index)
+{
+	SyncHandles();
+	return details[index].handle;
+}
+
+BodyHandle PhysicsSimulation::AddBody(const PhysicsBodyDef& def)
+{
+	PhysicsBody body;
+	body.position = def.position;
+	body.velocity = def.velocity;
+	body.SetGravityScale(def.gravityScale);
+	body.colliderType = def.colliderType;
+	body.forceGroups = def.forceGroups;
+	if (def.colliderType == COLLIDER_TYPE_CIRCLE)
+		body.radius = def.collider.circle.radius;
+	objects.push_back(body);
+	SyncHandles();
+
+	PhysicsBodyDetails& added = details.back();
+	added.color = def.color;
+	added.drag = def.drag;
+	if (def.colliderType == COLLIDER_TYPE_HALF_SPACE)
+		added.normal = def.collider.halfSpace.normal;
+	return added.handle;
+}
+
+int PhysicsSimulation::IndexOf(BodyHandle handle) const
+{
+	uint32_t slot = HandleSlotOf(handle);
+	if (handle == BODY_HANDLE_NONE || slot >= handleSlots.size() || handleSlots[slot].generation != HandleGeneration(handle))
+		return -1;
+	return handleSlots[slot].index;
+}
+
+PhysicsBody* PhysicsSimulation::Find(BodyHandle handle)
+{
+	int index = IndexOf(handle);
+	return index >= 0 ? &objects[index] : nullptr;
+}
+
+void PhysicsSimulation::UpdateSleeping(float elapsed)
+{
+	PhysicsStepStats& stats = lastStats;
+	float maxStep = sleepSpeed * dt;
+
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		PhysicsBody& o = objects[i];
+		float& restTime = timers[i].restTime;
+		if (o.IsStatic())
+		{
+			stats.staticBodies++;
+			continue;
+		}
+
+		// A deferred body didn't move because it wasn't its turn, that says nothing about it resting
+		if (allowSleeping && !o.sleeping && !o.deferred && i < (int)stepStartPositions.size())
+		{
+			// Judge by how far the body really got after collisions, its velocity keeps growing while it rests
+			if (Vector2DistanceSqr(o.position, stepStartPositions[i]) < maxStep * maxStep)
+				restTime += elapsed;
+			else
+				restTime = 0.0f;
+
+			if (restTime >= sleepDelay)
+			{
+				o.sleeping = true;
+				o.velocity = Vector2Zeros;
+			}
+		}
+
+		if (o.sleeping)
+			stats.sleepingBodies++;
+		else
+			stats.activeBodies++;
+	}
+}
+
+void PhysicsSimulation::WakeAll()
+{
+	for (PhysicsBody& o : objects)
+		o.sleeping = false;
+	for (PhysicsBodyTimers& t : timers)
+		t.restTime = 0.0f;
+}
+
+// Start of a snapshot. The scalars of the simulation follow it, then the body arrays: objects, timers, details,
+// then the step start positions if any, the force generators, and the handle table: the free slots in the order
+// they're handed out again and the generation of every slot, so a restored world hands out the same handles.
+struct SnapshotHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t bodyCount;
+	uint32_t stepStartCount; // Only kept for the adaptive timestep, which sizes the next step by them
+	uint32_t forceGeneratorCount;
+	uint32_t handleSlotCount;
+	uint32_t freeHandleSlotCount;
+};
+
+static const char SNAPSHOT_MAGIC[4] = { 'P', 'S', 'N', 'P' };
+static const uint32_t SNAPSHOT_VERSION = 11;
+
+static const size_t SNAPSHOT_BYTES_PER_BODY = sizeof(PhysicsBody) + sizeof(PhysicsBodyTimers) + sizeof(PhysicsBodyDetails);
+
+// The structs below have padding, so their fields are written one by one. A new field has to be added to the list too.
+static_assert(sizeof(PhysicsStepStats) == 80 && sizeof(PhysicsStepTimings) == 32 && sizeof(AdaptiveTimestep) == 16 &&
+	sizeof(PhysicsBudget) == 36, "Add the new field to PhysicsSimulation::SnapshotScalars()");
+
+// Calls field() on every scalar the snapshot carries, in order. Field by field, padding never reaches the buffer
+// and equal worlds give equal snapshots. Saving and restoring walk the same list, they can't disagree on the layout.
+template <typename Simulation, typename Field>
+void PhysicsSimulation::SnapshotScalars(Simulation& sim, Field&& field)
+{
+	field(sim.dt);
+	field(sim.time);
+	field(sim.stepCount);
+	uint64_t lastBodyCount = sim.lastBodyCount; // size_t isn't the same size everywhere
+	field(lastBodyCount);
+	if constexpr (!std::is_const<Simulation>::value)
+		sim.lastBodyCount = (size_t)lastBodyCount;
+
+	field(sim.gravity);
+	field(sim.broadphaseCellSize);
+	field(sim.allowSleeping);
+	field(sim.sleepSpeed);
+	field(sim.sleepDelay);
+	field(sim.cullingEnabled);
+	field(sim.cullBounds);
+	field(sim.recordTimings);
+
+	auto& stats = sim.lastStats;
+	field(stats.step);
+	field(stats.activeBodies);
+	field(stats.sleepingBodies);
+	field(stats.staticBodies);
+	field(stats.reducedRateBodies);
+	field(stats.candidatePairs);
+	field(stats.narrowphaseTests);
+	field(stats.narrowphaseHits);
+	field(stats.contactsResolved);
+	field(stats.broadphaseEfficiency);
+	field(stats.stepDt);
+	field(stats.time);
+	field(stats.bodiesSpawned);
+	field(stats.bodiesCulled);
+	field(stats.bodiesReordered);
+	field(stats.scratchBytes);
+	field(stats.qualityTier);
+	field(stats.stepCostMs);
+
+	field(sim.lastTimings.integrateMs);
+	field(sim.lastTimings.broadphaseMs);
+	field(sim.lastTimings.narrowphaseMs);
+	field(sim.lastTimings.resolveMs);
+
+	field(sim.substeps);
+	field(sim.solverIterations);
+	field(sim.integrator);
+	field(sim.adaptiveTimestep.enabled);
+	field(sim.adaptiveTimestep.minDt);
+	field(sim.adaptiveTimestep.maxDt);
+	field(sim.adaptiveTimestep.cfl);
+	field(sim.reorderEnabled);
+	field(sim.reorderInterval);
+	field(sim.reorderWindow);
+	field(sim.reorderCursor);
+	field(sim.reorderBackward);
+	field(sim.lodEnabled);
+	field(sim.focusBounds);
+	field(sim.lodHalfRateDistance);
+	field(sim.lodQuarterRateDistance);
+	field(sim.lodHoldTime);
+	field(sim.deferredWorkInterval);
+
+	field(sim.budget.enabled);
+	field(sim.budget.budgetMs);
+	field(sim.budget.degradeAbove);
+	field(sim.budget.restoreBelow);
+	field(sim.budget.settleSteps);
+	for (auto& degradation : sim.budget.order)
+		field(degradation);
+	field(sim.budget.orderCount);
+
+	field(sim.qualityTier);
+	field(sim.stepCostMs);
+	field(sim.stepsSinceTierChange);
+	field(sim.stepsUnderBudget);
+	field(sim.lastDeferredWorkStep);
+}
+
+// Bodies start 8 byte aligned so a snapshot can also be read in place
+size_t PhysicsSimulation::SnapshotBodiesOffset() const
+{
+	size_t size = sizeof(SnapshotHeader);
+	SnapshotScalars(*this, [&](const auto& value) { size += sizeof(value); });
+	return (size + 7) & ~(size_t)7;
+}
+
+// Step start positions the snapshot carries
+static size_t SnapshotStepStarts(const PhysicsSimulation& sim)
+{
+	return sim.adaptiveTimestep.enabled ? sim.StepStartPositions().size() : 0;
+}
+
+size_t PhysicsSimulation::SnapshotSize() const
+{
+	return SnapshotBodiesOffset() + objects.size() * SNAPSHOT_BYTES_PER_BODY + SnapshotStepStarts(*this) * sizeof(Vector2) +
+		forceGenerators.size() * sizeof(ForceGenerator) + freeHandleSlots.size() * sizeof(uint32_t) + handleSlots.size();
+}
+
+void PhysicsSimulation::SaveSnapshot(std::vector<unsigned char>& buffer) const
+{
+	buffer.resize(SnapshotSize());
+	SaveSnapshot(buffer.data(), buffer.size());
+}
+
+size_t PhysicsSimulation::SaveSnapshot(void* buffer, size_t capacity) const
+{
+	size_t size = SnapshotSize();
+	if (capacity < size)
+		return 0;
+
+	SnapshotHeader header = {};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.bodyCount = (uint32_t)objects.size();
+	header.stepStartCount = (uint32_t)SnapshotStepStarts(*this);
+	header.forceGeneratorCount = (uint32_t)forceGenerators.size();
+	header.handleSlotCount = (uint32_t)handleSlots.size();
+	header.freeHandleSlotCount = (uint32_t)freeHandleSlots.size();
+
+	unsigned char* out = (unsigned char*)buffer;
+	unsigned char* bodies = out + SnapshotBodiesOffset();
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	SnapshotScalars(*this, [&](const auto& value)
+	{
+		memcpy(out, &value, sizeof(value));
+		out += sizeof(value);
+	});
+	memset(out, 0, bodies - out);
+	out = bodies;
+	if (!objects.empty())
+	{
+		memcpy(out, objects.data(), objects.size() * sizeof(PhysicsBody));
+		out += objects.size() * sizeof(PhysicsBody);
+
+		// Bodies appended since the last step don't have theirs yet, they get the defaults SyncHandles() would give them
+		auto write = [&](const auto& items)
+		{
+			typedef typename std::decay<decltype(items[0])>::type Item;
+			size_t have = std::min(items.size(), objects.size());
+			memcpy(out, items.data(), have * sizeof(Item));
+			out += have * sizeof(Item);
+			for (size_t i = have; i < objects.size(); ++i, out += sizeof(Item))
+			{
+				Item item;
+				memcpy(out, &item, sizeof(Item));
+			}
+		};
+		write(timers);
+		write(details);
+	}
+	if (header.stepStartCount > 0)
+		memcpy(out, stepStartPositions.data(), header.stepStartCount * sizeof(Vector2));
+	out += header.stepStartCount * sizeof(Vector2);
+	if (header.forceGeneratorCount > 0)
+		memcpy(out, forceGenerators.data(), header.forceGeneratorCount * sizeof(ForceGenerator));
+	out += header.forceGeneratorCount * sizeof(ForceGenerator);
+	if (header.freeHandleSlotCount > 0)
+		memcpy(out, freeHandleSlots.data(), header.freeHandleSlotCount * sizeof(uint32_t));
+	out += header.freeHandleSlotCount * sizeof(uint32_t);
+	for (const HandleSlot& slot : handleSlots)
+		*out++ = slot.generation;
+	return size;
+}
+
+bool PhysicsSimulation::RestoreSnapshot(const void* buffer, size_t size)
+{
+	SnapshotHeader header;
+	if (size < sizeof(header))
+		return false;
+
+	memcpy(&header, buffer, sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION)
+		return false;
+	size_t bodiesOffset = SnapshotBodiesOffset();
+	size_t startsOffset = bodiesOffset + header.bodyCount * SNAPSHOT_BYTES_PER_BODY;
+	size_t forcesOffset = startsOffset + header.stepStartCount * sizeof(Vector2);
+	size_t freeSlotsOffset = forcesOffset + header.forceGeneratorCount * sizeof(ForceGenerator);
+	size_t generationsOffset = freeSlotsOffset + header.freeHandleSlotCount * sizeof(uint32_t);
+	if (size < generationsOffset + header.handleSlotCount)
+		return false;
+
+	const unsigned char* in = (const unsigned char*)buffer + sizeof(header);
+	SnapshotScalars(*this, [&](auto& value)
+	{
+		memcpy(&value, in, sizeof(value));
+		in += sizeof(value);
+	});
+
+	in = (const unsigned char*)buffer + bodiesOffset;
+
+	objects.resize(header.bodyCount);
+	timers.resize(header.bodyCount);
+	details.resize(header.bodyCount);
+	if (header.bodyCount > 0)
+	{
+		memcpy(objects.data(), in, header.bodyCount * sizeof(PhysicsBody));
+		in += header.bodyCount * sizeof(PhysicsBody);
+		memcpy(timers.data(), in, header.bodyCount * sizeof(PhysicsBodyTimers));
+		in += header.bodyCount * sizeof(PhysicsBodyTimers);
+		memcpy(details.data(), in, header.bodyCount * sizeof(PhysicsBodyDetails));
+	}
+
+	stepStartPositions.resize(header.stepStartCount);
+	if (header.stepStartCount > 0)
+		memcpy(stepStartPositions.data(), (const unsigned char*)buffer + startsOffset, header.stepStartCount * sizeof(Vector2));
+	forceGenerators.resize(header.forceGeneratorCount);
+	if (header.forceGeneratorCount > 0)
+		memcpy(forceGenerators.data(), (const unsigned char*)buffer + forcesOffset, header.forceGeneratorCount * sizeof(ForceGenerator));
+
+	// The details brought the handles, the table follows them
+	RestoreHandles((const unsigned char*)buffer + generationsOffset, header.handleSlotCount,
+		(const unsigned char*)buffer + freeSlotsOffset, header.freeHandleSlotCount);
+
+	// The grid and the contacts are rebuilt by every step, drop them rather than carry megabytes of buckets around
+	contacts.Clear();
+	broadphase.Clear();
+	return true;
+}
+
+SpatialGrid& SpatialGrid::operator=(const SpatialGrid& other)
+{
+	if (this == &other)
+		return *this;
+
+	Clear();
+	cellSize = other.cellSize;
+	inverseCellSize = other.inverseCellSize;
+	hashMask = other.hashMask;
+	minCellX = other.minCellX;
+	minCellY = other.minCellY;
+	maxCellX = other.maxCellX;
+	maxCellY = other.maxCellY;
+
+	// bucketFill only matters while building
+	auto copy = [&](auto& to, const auto& from)
+	{
+		to.Resize(storage, from.Size());
+		std::copy(from.begin(), from.end(), to.begin());
+	};
+	copy(bucketStart, other.bucketStart);
+	copy(entries, other.entries);
+	copy(halfSpaces, other.halfSpaces);
+	return *this;
+}
+
+void SpatialGrid::Clear()
+{
+	bucketStart.Release();
+	bucketFill.Release();
+	entries.Release();
+	halfSpaces.Release();
+	storage.Reset();
+	minCellX = minCellY = 0;
+	maxCellX = maxCellY = -1;
+}
+
+void PhysicsSimulation::UpdateBroadphase()
+{
+	SpatialGrid& grid = broadphase;
+	grid.Clear();
+	grid.minCellX = grid.minCellY = INT32_MAX;
+	grid.maxCellX = grid.maxCellY = INT32_MIN;
+
+	float cellSize = broadphaseCellSize;
+	if (cellSize <= 0.0f)
+	{
+		float maxRadius = 0.0f;
+		for (const PhysicsBody& o : objects)
+			if (o.colliderType == COLLIDER_TYPE_CIRCLE)
+				maxRadius = fmaxf(maxRadius, o.radius);
+		cellSize = fmaxf(2.0f * maxRadius, 1.0f);
+	}
+	grid.cellSize = cellSize;
+	grid.inverseCellSize = 1.0f / cellSize;
+
+	// Count the cells every circle covers to size the table
+	int entryCount = 0;
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		const PhysicsBody& o = objects[i];
+		if (o.colliderType == COLLIDER_TYPE_HALF_SPACE)
+		{
+			grid.halfSpaces.PushBack(grid.storage, i);
+			continue;
+		}
+		if (o.colliderType != COLLIDER_TYPE_CIRCLE)
+			continue;
+
+		float r = o.radius;
+		int x0 = grid.CellCoord(o.position.x - r), x1 = grid.CellCoord(o.position.x + r);
+		int y0 = grid.CellCoord(o.position.y - r), y1 = grid.CellCoord(o.position.y + r);
+		entryCount += (x1 - x0 + 1) * (y1 - y0 + 1);
+	}
+
+	uint32_t tableSize = 64;
+	while (tableSize < (uint32_t)entryCount * 2)
+		tableSize <<= 1;
+	grid.hashMask = tableSize - 1;
+	grid.bucketStart.Resize(grid.storage, tableSize + 1);
+	std::fill(grid.bucketStart.begin(), grid.bucketStart.end(), 0);
+	grid.bucketFill.Resize(grid.storage, tableSize);
+	grid.entries.Resize(grid.storage, entryCount);
+
+	// Counting sort: bucket sizes, prefix sum, then scatter
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < (int)objects.size(); ++i)
+		{
+			const PhysicsBody& o = objects[i];
+			if (o.colliderType != COLLIDER_TYPE_CIRCLE)
+				continue;
+
+			float r = o.radius;
+			int x0 = grid.CellCoord(o.position.x - r), x1 = grid.CellCoord(o.position.x + r);
+			int y0 = grid.CellCoord(o.position.y - r), y1 = grid.CellCoord(o.position.y + r);
+
+			for (int y = y0; y <= y1; ++y)
+				for (int x = x0; x <= x1; ++x)
+				{
+					uint32_t bucket = grid.Hash(x, y);
+					if (pass == 0)
+						grid.bucketStart[bucket + 1]++;
+					else
+						grid.entries[grid.bucketFill[bucket]++] = { x, y, x0, y0, i };
+				}
+
+			if (pass == 0)
+			{
+				grid.minCellX = std::min(grid.minCellX, x0);
+				grid.minCellY = std::min(grid.minCellY, y0);
+				grid.maxCellX = std::max(grid.maxCellX, x1);
+				grid.maxCellY = std::max(grid.maxCellY, y1);
+			}
+		}
+
+		if (pass == 0)
+		{
+			for (uint32_t b = 0; b < tableSize; ++b)
+				grid.bucketStart[b + 1] += grid.bucketStart[b];
+			std::copy(grid.bucketStart.begin(), grid.bucketStart.end() - 1, grid.bucketFill.begin());
+		}
+	}
+}
+
+int PhysicsSimulation::QueryPoint(Vector2 point, int* results, int maxResults) const
+{
+	int count = 0;
+	ForEachCandidate(point, point, [&](int i)
+	{
+		const PhysicsBody& o = objects[i];
+		float r = o.radius;
+		if (count < maxResults && Vector2DistanceSqr(point, o.position) <= r * r)
+			results[count++] = i;
+	});
+
+	for (int i : broadphase.halfSpaces)
+	{
+		const PhysicsBody& o = objects[i];
+		if (count < maxResults && Vector2DotProduct(point - o.position, details[i].normal) <= 0.0f)
+			results[count++] = i;
+	}
+	return count;
+}
+
+int PhysicsSimulation::QueryAABB(Rectangle box, int* results, int maxResults) const
+{
+	Vector2 boxMin = { box.x, box.y };
+	Vector2 boxMax = { box.x + box.width, box.y + box.height };
+
+	int count = 0;
+	ForEachCandidate(boxMin, boxMax, [&](int i)
+	{
+		const PhysicsBody& o = objects[i];
+		float r = o.radius;
+		Vector2 closest = Vector2Clamp(o.position, boxMin, boxMax);
+		if (count < maxResults && Vector2DistanceSqr(closest, o.position) <= r * r)
+			results[count++] = i;
+	});
+
+	for (int i : broadphase.halfSpaces)
+	{
+		const PhysicsBody& o = objects[i];
+		Vector2 n = details[i].normal;
+
+		// The box corner furthest against the normal is the deepest one
+		Vector2 corner = { n.x > 0.0f ? boxMin.x : boxMax.x, n.y > 0.0f ? boxMin.y : boxMax.y };
+		if (count < maxResults && Vector2DotProduct(corner - o.position, n) <= 0.0f)
+			results[count++] = i;
+	}
+	return count;
+}
+
+int PhysicsSimulation::QueryCircle(Vector2 center, float radius, int* results, int maxResults) const
+{
+	Vector2 extent = { radius, radius };
+
+	int count = 0;
+	ForEachCandidate(center - extent, center + extent, [&](int i)
+	{
+		const PhysicsBody& o = objects[i];
+		if (count < maxResults && CircleCircle(center, radius, o.position, o.radius))
+			results[count++] = i;
+	});
+
+	for (int i : broadphase.halfSpaces)
+	{
+		const PhysicsBody& o = objects[i];
+		if (count < maxResults && CircleHalfSpace(center, radius, o.position, details[i].normal))
+			results[count++] = i;
+	}
+	return count;
+}
+
+bool PhysicsSimulation::Raycast(Vector2 origin, Vector2 direction, float maxDistance, RaycastHit* hit) const
+{
+	const SpatialGrid& grid = broadphase;
+	Vector2 d = Vector2Normalize(direction);
+	if (d.x == 0.0f && d.y == 0.0f)
+		return false;
+
+	RaycastHit best;
+	best.distance = maxDistance;
+
+	for (int i : grid.halfSpaces)
+	{
+		const PhysicsBody& o = objects[i];
+		Vector2 n = details[i].normal;
+		float height = Vector2DotProduct(origin - o.position, n);
+		float approach = Vector2DotProduct(d, n);
+
+		float t = -1.0f;
+		if (height <= 0.0f)
+			t = 0.0f; // Starts inside
+		else if (approach < 0.0f)
+			t = -height / approach;
+
+		if (t >= 0.0f && t <= best.distance)
+		{
+			best.body = i;
+			best.distance = t;
+			best.normal = n;
+		}
+	}
+
+	if (!grid.entries.Empty())
+	{
+		// Clip the ray to the occupied cells so empty space isn't walked
+		Vector2 boundsMin = { grid.minCellX * grid.cellSize, grid.minCellY * grid.cellSize };
+		Vector2 boundsMax = { (grid.maxCellX + 1) * grid.cellSize, (grid.maxCellY + 1) * grid.cellSize };
+		float tEnter = 0.0f, tExit = best.distance;
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			float o = axis == 0 ? origin.x : origin.y;
+			float v = axis == 0 ? d.x : d.y;
+			float lo = axis == 0 ? boundsMin.x : boundsMin.y;
+			float hi = axis == 0 ? boundsMax.x : boundsMax.y;
+			if (v == 0.0f)
+			{
+				if (o < lo || o > hi)
+					tExit = -1.0f;
+				continue;
+			}
+			float t0 = (lo - o) / v, t1 = (hi - o) / v;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			tEnter = fmaxf(tEnter, t0);
+			tExit = fminf(tExit, t1);
+		}
+
+		if (tEnter <= tExit)
+		{
+			Vector2 p = origin + d * tEnter;
+			int x = grid.CellCoord(p.x), y = grid.CellCoord(p.y);
+			int stepX = d.x > 0.0f ? 1 : -1, stepY = d.y > 0.0f ? 1 : -1;
+			float tDeltaX = d.x != 0.0f ? grid.cellSize / fabsf(d.x) : INFINITY;
+			float tDeltaY = d.y != 0.0f ? grid.cellSize / fabsf(d.y) : INFINITY;
+			float tMaxX = d.x != 0.0f ? tEnter + ((x + (stepX > 0)) * grid.cellSize - p.x) / d.x : INFINITY;
+			float tMaxY = d.y != 0.0f ? tEnter + ((y + (stepY > 0)) * grid.cellSize - p.y) / d.y : INFINITY;
+
+			for (;;)
+			{
+				uint32_t bucket = grid.Hash(x, y);
+				for (int e = grid.bucketStart[bucket]; e < grid.bucketStart[bucket + 1]; ++e)
+				{
+					const SpatialGrid::Entry& entry = grid.entries[e];
+					if (entry.cellX != x || entry.cellY != y)
+						continue;
+
+					const PhysicsBody& o = objects[entry.body];
+					float r = o.radius;
+					Vector2 m = origin - o.position;
+					float b = Vector2DotProduct(m, d);
+					float c = Vector2DotProduct(m, m) - r * r;
+					if (c > 0.0f && b > 0.0f)
+						continue; // Outside and pointing away
+					float discriminant = b * b - c;
+					if (discriminant < 0.0f)
+						continue;
+
+					float t = fmaxf(-b - sqrtf(discriminant), 0.0f);
+					if (t <= best.distance)
+					{
+						best.body = entry.body;
+						best.distance = t;
+						best.normal = c > 0.0f ? Vector2Normalize(origin + d * t - o.position) : Vector2Negate(d);
+					}
+				}
+
+				// Anything hit inside this cell is closer than whatever the next cells hold
+				float cellExit = fminf(tMaxX, tMaxY);
+				if (best.body >= 0 && best.distance <= cellExit)
+					break;
+				if (cellExit > tExit)
+					break;
+
+				if (tMaxX < tMaxY)
+				{
+					x += stepX;
+					tMaxX += tDeltaX;
+				}
+				else
+				{
+					y += stepY;
+					tMaxY += tDeltaY;
+				}
+			}
+		}
+	}
+
+	if (best.body < 0)
+		return false;
+
+	best.point = origin + d * best.distance;
+	if (hit != nullptr)
+		*hit = best;
+	return true;
+}
+
+void PhysicsSimulation::CheckCollision()
+{
+	UpdateBroadphase();
+	FindContacts();
+
+	// Keep queries in sync with the resolved positions
+	if (ResolveContacts(solverIterations) > 0)
+		UpdateBroadphase();
+}
+
+// Sleeping, deferred and static bodies don't move this step, a pair of them can't start touching
+static bool IsResting(const PhysicsBody& o)
+{
+	return o.sleeping || o.deferred || o.IsStatic();
+}
+
+// A reduced rate body near a full-rate one goes back to full rate, so the two meet at the same time
+void PhysicsSimulation::PromoteNearFullRate(int a, int b)
+{
+	if (objects[a].lodLevel > 0 && objects[b].lodLevel == 0 && !IsResting(objects[b]))
+		timers[a].lodHoldTime = lodHoldTime;
+	else if (objects[b].lodLevel > 0 && objects[a].lodLevel == 0 && !IsResting(objects[a]))
+		timers[b].lodHoldTime = lodHoldTime;
+}
+
+// A body that moved last step wakes a sleeping body it runs into
+void PhysicsSimulation::WakeOnContact(int a, int b)
+{
+	PhysicsBody& oa = objects[a];
+	PhysicsBody& ob = objects[b];
+	if (oa.sleeping && !ob.sleeping && !ob.IsStatic() && timers[b].restTime == 0.0f)
+		oa.sleeping = false, timers[a].restTime = 0.0f;
+	else if (ob.sleeping && !oa.sleeping && !oa.IsStatic() && timers[a].restTime == 0.0f)
+		ob.sleeping = false, timers[b].restTime = 0.0f;
+}
+
+void PhysicsSimulation::FindContacts()
+{
+	contacts.Clear();
+	PhysicsStepStats& stats = lastStats;
+
+	// No collision possible
+	if (objects.size() < 2)
+		return; 
+	SyncHandles(); // Details and timers for bodies appended outside of a step
+
+	bool lod = lodEnabled || IsDegraded(BUDGET_DEGRADE_FAR_BODIES);
+	auto test = [&](int a, int b)
+	{
+		stats.candidatePairs++;
+		if (lod)
+			PromoteNearFullRate(a, b);
+		if (IsResting(objects[a]) && IsResting(objects[b]))
+			return;
+
+		stats.narrowphaseTests++;
+		if (Overlaps(a, b))
+		{
+			stats.narrowphaseHits++;
+			WakeOnContact(a, b);
+			contacts.PushBack(scratch, { a, b });
+		}
+	};
+
+	// Circle pairs come from the grid, each pair is visited once: two moving bodies with i < j,
+	// a moving and a resting body from the moving side. Resting bodies don't look for partners,
+	// so far bodies sitting out the step or asleep cost next to nothing here.
+	for (int i = 0; i < (int)objects.size(); ++i)
+	{
+		if (objects[i].colliderType != COLLIDER_TYPE_CIRCLE || IsResting(objects[i]))
+			continue;
+
+		float r = objects[i].radius;
+		Vector2 extent = { r, r };
+		ForEachCandidate(objects[i].position - extent, objects[i].position + extent, [&](int j)
+		{
+			if (j > i)
+				test(i, j);
+			else if (IsResting(objects[j]))
+				test(j, i);
+		});
+	}
+
+	// Half-spaces are few, test them against every circle and resolve them last so nothing ends up inside a wall
+	for (int h : broadphase.halfSpaces)
+		for (int i = 0; i < (int)objects.size(); ++i)
+			if (objects[i].colliderType == COLLIDER_TYPE_CIRCLE)
+				test(h, i);
+}
+
+int PhysicsSimulation::ResolveContacts(int iterations)
+{
+	// Pairs are resolved one after the other, so each sees the corrections made before it.
+	// Later passes settle the overlaps the earlier corrections pushed into neighbours.
+	int resolved = 0;
+	for (int pass = 0; pass < iterations; ++pass)
+	{
+		int overlapping = 0;
+		for (const Contact& c : contacts)
+			overlapping += ResolvePair(c.a, c.b);
+
+		if (pass == 0)
+			resolved = overlapping;
+		if (overlapping == 0)
+			break;
+	}
+	return resolved;
+}
+
+bool PhysicsSimulation::Overlaps(int ia, int ib)
+{
+	PhysicsBody& a = objects[ia];
+	PhysicsBody& b = objects[ib];
+	bool collision = false;
+	if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+		collision = CircleCircle(a.position, a.radius, b.position, b.radius);
+	else if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_HALF_SPACE)
+		collision = CircleHalfSpace(a.position, a.radius, b.position, details[ib].normal);
+	else if (a.colliderType == COLLIDER_TYPE_HALF_SPACE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+		collision = CircleHalfSpace(b.position, b.radius, a.position, details[ia].normal);
+
+	a.collision |= collision;
+	b.collision |= collision;
+	return collision;
+}
+
+bool PhysicsSimulation::ResolvePair(int ia, int ib)
+{
+	PhysicsBody& a = objects[ia];
+	PhysicsBody& b = objects[ib];
+
+	// Ensures both have a type
+	assert(a.colliderType != COLLIDER_TYPE_INVALID && b.colliderType != COLLIDER_TYPE_INVALID);
+	bool collision = false;
+
+	// mtv = minimum translation vector
+	Vector2 mtv = Vector2Zeros;
+	
+	if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+		collision = CircleCircle(
+			a.position, a.radius, 
+			b.position, b.radius,
+			&mtv);
+
+	else if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_HALF_SPACE)
+		collision = CircleHalfSpace(
+			a.position, a.radius,
+			b.position, details[ib].normal,
+			&mtv);
+
+	else if (a.colliderType == COLLIDER_TYPE_HALF_SPACE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+		collision = CircleHalfSpace(
+			b.position, b.radius,
+			a.position, details[ia].normal,
+			&mtv);
+
+	a.collision |= collision;
+	b.collision |= collision; // only if single true
+
+	if (collision)
+	{
+		// move only circles
+		if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_HALF_SPACE)
+			a.position += mtv;
+		if (a.colliderType == COLLIDER_TYPE_HALF_SPACE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+			b.position += mtv; 
+
+		if (a.colliderType == COLLIDER_TYPE_CIRCLE && b.colliderType == COLLIDER_TYPE_CIRCLE)
+		{
+			// Move both circles apart equally
+			a.position += mtv * 0.5f;
+			b.position -= mtv * 0.5f;
+		}
+	}
+
+	return collision;
+}
+
+bool PhysicsSimulation::CircleCircle(Vector2 pos1, float rad1, Vector2 pos2, float rad2, Vector2* mtv)
+{
+	typedef PhysicsKernels<float>::Vector Vector;
+	Vector realMtv;
+	bool collision = PhysicsKernels<float>::CircleCircle(Vector::From(pos1), rad1,
+		Vector::From(pos2), rad2, mtv != nullptr ? &realMtv : nullptr);
+	if (collision && mtv != nullptr)
+		*mtv = realMtv.ToVector2();
+	return collision;
+}
+
+bool PhysicsSimulation::CircleHalfSpace(Vector2 circlePos, float rad, Vector2 posHalfSpace, Vector2 normal, Vector2* mtv)
+{
+	typedef PhysicsKernels<float>::Vector Vector;
+	Vector realMtv;
+	bool collision = PhysicsKernels<float>::CircleHalfSpace(Vector::From(circlePos), rad,
+		Vector::From(posHalfSpace), Vector::From(normal), mtv != nullptr ? &realMtv : nullptr);
+	if (collision && mtv != nullptr)
+		*mtv = realMtv.ToVector2();
+	return collision;
+}
@@ -0,0 +1,252 @@
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct TraceEvent
+	{
+		int zone;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// Written only by its thread, read by EndFrame() and EndCapture()
+	struct ThreadBuffer
+	{
+		static constexpr int MAX_EVENTS = 1 << 18;
+
+		int threadId = 0;
+		std::atomic<uint64_t> totals[Profiler::MAX_ZONES] = {}; // Nanoseconds per zone since the start
+		uint64_t lastTotals[Profiler::MAX_ZONES] = {}; // Seen by the previous EndFrame()
+		std::unique_ptr<TraceEvent[]> events;
+		std::atomic<int> eventCount{ 0 };
+		std::atomic<uint32_t> capture{ 0 }; // Capture the events belong to, the owner resets eventCount when it changes
+	};
+
+	std::mutex registryMutex; // Guards registration only, never taken while timing
+	std::vector<std::unique_ptr<ThreadBuffer>> threads;
+	int nextThreadId = 1;
+	const char* zoneNames[Profiler::MAX_ZONES];
+	std::atomic<int> zoneCount{ 0 };
+	std::atomic<bool> capturing{ false };
+	std::atomic<uint32_t> captureGeneration{ 0 }; // Counts BeginCapture() calls
+	uint64_t captureStart = 0;
+
+	// Per zone ring of frame totals, plus frame times
+	double zoneHistory[Profiler::MAX_ZONES][Profiler::HISTORY];
+	double frameHistory[Profiler::HISTORY];
+	int historyHead = 0;
+	int historyCount = 0; // Frames recorded so far, up to HISTORY
+	uint64_t lastFrameEnd = 0;
+
+	// The calling thread's buffer, unregistered when the thread exits
+	struct ThreadRegistration
+	{
+		ThreadBuffer* buffer = nullptr;
+		~ThreadRegistration() { Profiler::UnregisterThread(); }
+	};
+	thread_local ThreadRegistration registration;
+
+	ThreadBuffer& LocalBuffer()
+	{
+		if (registration.buffer == nullptr)
+			Profiler::RegisterThread();
+		return *registration.buffer;
+	}
+}
+
+void Profiler::RegisterThread()
+{
+	if (registration.buffer != nullptr)
+		return;
+
+	// Allocated outside the lock, the events are megabytes
+	std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+	buffer->events.reset(new TraceEvent[ThreadBuffer::MAX_EVENTS]);
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->threadId = nextThreadId++;
+	registration.buffer = buffer.get();
+	threads.push_back(std::move(buffer));
+}
+
+void Profiler::UnregisterThread()
+{
+	if (registration.buffer == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		if (threads[i].get() == registration.buffer)
+		{
+			threads.erase(threads.begin() + i);
+			break;
+		}
+	}
+	registration.buffer = nullptr;
+}
+
+std::atomic<bool> Profiler::enabled{ false };
+
+void Profiler::SetEnabled(bool on)
+{
+	enabled.store(on, std::memory_order_relaxed);
+}
+
+int Profiler::RegisterZone(const char* name)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	int count = zoneCount.load();
+	for (int i = 0; i < count; ++i)
+		if (strcmp(zoneNames[i], name) == 0)
+			return i;
+
+	if (count == MAX_ZONES)
+		return MAX_ZONES - 1; // Out of slots, share the last one
+	zoneNames[count] = name;
+	zoneCount.store(count + 1);
+	return count;
+}
+
+uint64_t Profiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Record(int zone, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = LocalBuffer();
+
+	// Only this thread writes its totals, readers just need the value to be whole
+	uint64_t total = buffer.totals[zone].load(std::memory_order_relaxed);
+	buffer.totals[zone].store(total + (end - start), std::memory_order_relaxed);
+
+	if (capturing.load(std::memory_order_acquire))
+	{
+		// First event of a new capture: only this thread writes eventCount, so it starts it over itself
+		uint32_t generation = captureGeneration.load(std::memory_order_relaxed);
+		if (buffer.capture.load(std::memory_order_relaxed) != generation)
+		{
+			buffer.eventCount.store(0, std::memory_order_relaxed);
+			buffer.capture.store(generation, std::memory_order_release);
+		}
+
+		int n = buffer.eventCount.load(std::memory_order_relaxed);
+		if (n < ThreadBuffer::MAX_EVENTS)
+		{
+			buffer.events[n] = { zone, start, end };
+			buffer.eventCount.store(n + 1, std::memory_order_release);
+		}
+	}
+}
+
+void Profiler::EndFrame()
+{
+	uint64_t now = Now();
+	double frameMs = lastFrameEnd != 0 ? (now - lastFrameEnd) * 1e-6 : 0.0;
+	lastFrameEnd = now;
+
+	double frameZones[MAX_ZONES] = {};
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (std::unique_ptr<ThreadBuffer>& thread : threads)
+			for (int z = 0; z < MAX_ZONES; ++z)
+			{
+				uint64_t total = thread->totals[z].load(std::memory_order_relaxed);
+				frameZones[z] += (total - thread->lastTotals[z]) * 1e-6;
+				thread->lastTotals[z] = total;
+			}
+	}
+
+	for (int z = 0; z < MAX_ZONES; ++z)
+		zoneHistory[z][historyHead] = frameZones[z];
+	frameHistory[historyHead] = frameMs;
+	historyHead = (historyHead + 1) % HISTORY;
+	historyCount = historyCount < HISTORY ? historyCount + 1 : HISTORY;
+}
+
+int Profiler::ZoneCount()
+{
+	return zoneCount.load();
+}
+
+ProfileZoneStats Profiler::GetZone(int id)
+{
+	ProfileZoneStats stats;
+	stats.name = zoneNames[id];
+	stats.lastMs = zoneHistory[id][(historyHead + HISTORY - 1) % HISTORY];
+
+	double sum = 0.0;
+	for (int i = 0; i < HISTORY; ++i)
+		sum += zoneHistory[id][i];
+	stats.averageMs = historyCount > 0 ? sum / historyCount : 0.0;
+	return stats;
+}
+
+void Profiler::GetFrameHistory(float* frameMs)
+{
+	for (int i = 0; i < HISTORY; ++i)
+		frameMs[i] = (float)frameHistory[(historyHead + i) % HISTORY];
+}
+
+double Profiler::AverageFrameMs()
+{
+	double sum = 0.0;
+	for (int i = 0; i < HISTORY; ++i)
+		sum += frameHistory[i];
+	return historyCount > 0 ? sum / historyCount : 0.0;
+}
+
+void Profiler::BeginCapture()
+{
+	// The threads see the new generation and drop their old events on their next zone
+	captureStart = Now();
+	captureGeneration.fetch_add(1, std::memory_order_relaxed);
+	capturing.store(true, std::memory_order_release);
+}
+
+bool Profiler::IsCapturing()
+{
+	return capturing.load(std::memory_order_relaxed);
+}
+
+bool Profiler::EndCapture(const char* path)
+{
+	capturing.store(false);
+
+	FILE* out = fopen(path, "w");
+	if (out == nullptr)
+		return false;
+
+	fprintf(out, "{\"traceEvents\":[\n");
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		uint32_t generation = captureGeneration.load(std::memory_order_relaxed);
+		for (std::unique_ptr<ThreadBuffer>& thread : threads)
+		{
+			// A thread that recorded nothing since BeginCapture() still holds an older capture
+			if (thread->capture.load(std::memory_order_acquire) != generation)
+				continue;
+			int count = thread->eventCount.load(std::memory_order_acquire);
+			for (int i = 0; i < count; ++i)
+			{
+				const TraceEvent& e = thread->events[i];
+				if (e.start < captureStart)
+					continue;
+				fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+					first ? "" : ",\n", zoneNames[e.zone], (e.start - captureStart) * 1e-3, (e.end - e.start) * 1e-3, thread->threadId);
+				first = false;
+			}
+		}
+	}
+	fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
@@ -0,0 +1,160 @@
+#include "scenes.h"
+
+void BuildFunnelScene(PhysicsSimulation& sim)
+{
+	PhysicsBodyDef entity;
+
+	// Gravity affected circle
+	entity = {};
+	entity.position = { 350.0f, 200.0f };
+	entity.collider.circle.radius = 20.0f;
+	entity.gravityScale = 1.0f;
+	entity.colliderType = COLLIDER_TYPE_CIRCLE;
+	entity.color = GREEN;
+	sim.AddBody(entity);
+
+	// Stationary half-space -45 degrees
+	entity = {};
+	entity.position = { 400.0f, 400.0f };
+	entity.gravityScale = 0.0f;
+	entity.colliderType = COLLIDER_TYPE_HALF_SPACE;
+	entity.color = PURPLE;
+	entity.collider.halfSpace.normal = Vector2Rotate(Vector2UnitX, -45.0f * DEG2RAD); // Pointing down 
+	sim.AddBody(entity);
+
+	// Stationary half-space 45 degrees
+	entity = {};
+	entity.position = { 800.0f, 400.0f };
+	entity.gravityScale = 0.0f;
+	entity.colliderType = COLLIDER_TYPE_HALF_SPACE;
+	entity.color = PURPLE;
+	entity.collider.halfSpace.normal = Vector2Rotate(Vector2UnitX, 225.0f * DEG2RAD); // Pointing down 
+	sim.AddBody(entity);
+}
+
+static void AddHalfSpace(PhysicsSimulation& sim, Vector2 position, float normalDegrees)
+{
+	PhysicsBodyDef b;
+	b.position = position;
+	b.gravityScale = 0.0f;
+	b.colliderType = COLLIDER_TYPE_HALF_SPACE;
+	b.color = PURPLE;
+	b.collider.halfSpace.normal = Vector2Rotate(Vector2UnitX, normalDegrees * DEG2RAD);
+	sim.AddBody(b);
+}
+
+static void AddCircle(PhysicsSimulation& sim, Vector2 position, Vector2 velocity, float radius, float gravityScale = 1.0f)
+{
+	PhysicsBodyDef b;
+	b.position = position;
+	b.velocity = velocity;
+	b.gravityScale = gravityScale;
+	b.colliderType = COLLIDER_TYPE_CIRCLE;
+	b.collider.circle.radius = radius;
+	b.color = GREEN;
+	sim.AddBody(b);
+}
+
+// Box open to the top with its floor at y = floor
+static void AddBox(PhysicsSimulation& sim, float left, float right, float floor)
+{
+	AddHalfSpace(sim, { 0.0f, floor }, 270.0f);
+	AddHalfSpace(sim, { left, 0.0f }, 0.0f);
+	AddHalfSpace(sim, { right, 0.0f }, 180.0f);
+}
+
+// Small deterministic generator so every run builds the same scene on every platform
+static float Random(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+void BuildFunnelFillScene(PhysicsSimulation& sim, int count)
+{
+	BuildFunnelScene(sim);
+
+	// Columns across the mouth of the funnel, rows stacked upwards
+	const float radius = 4.0f;
+	const int columns = 60;
+	for (int i = 0; i < count; ++i)
+	{
+		int row = i / columns;
+		int column = i % columns;
+		AddCircle(sim, { 360.0f + column * 2.0f * radius + (row & 1) * radius, 300.0f - row * 2.0f * radius }, Vector2Zeros, radius);
+	}
+}
+
+void BuildRainScene(PhysicsSimulation& sim, int count)
+{
+	float width = 20.0f * sqrtf((float)count) + 400.0f;
+	AddHalfSpace(sim, { 0.0f, 800.0f }, 270.0f);
+
+	uint32_t seed = 1;
+	for (int i = 0; i < count; ++i)
+	{
+		Vector2 position = { Random(seed) * width, 700.0f - Random(seed) * width };
+		Vector2 velocity = { (Random(seed) - 0.5f) * 100.0f, 100.0f + Random(seed) * 200.0f };
+		AddCircle(sim, position, velocity, 3.0f + Random(seed) * 3.0f);
+	}
+}
+
+void BuildPyramidScene(PhysicsSimulation& sim, int count)
+{
+	const float radius = 5.0f;
+	int base = (int)ceilf((sqrtf(8.0f * count + 1.0f) - 1.0f) * 0.5f);
+	float floor = 800.0f;
+	AddHalfSpace(sim, { 0.0f, floor }, 270.0f);
+
+	// Hexagonal packing, every row sits in the gaps of the one below
+	int placed = 0;
+	for (int row = 0; placed < count; ++row)
+	{
+		int inRow = base - row;
+		float y = floor - radius - row * radius * sqrtf(3.0f);
+		for (int k = 0; k < inRow && placed < count; ++k, ++placed)
+			AddCircle(sim, { 100.0f + row * radius + k * 2.0f * radius, y }, Vector2Zeros, radius);
+	}
+}
+
+void BuildSwarmScene(PhysicsSimulation& sim, int count)
+{
+	// About 1% of the area covered so most circles fly freely
+	const float radius = 3.0f;
+	float side = sqrtf(count * PI * radius * radius * 100.0f);
+	AddBox(sim, 0.0f, side, side);
+	AddHalfSpace(sim, { 0.0f, 0.0f }, 90.0f);
+
+	uint32_t seed = 2;
+	for (int i = 0; i < count; ++i)
+	{
+		Vector2 position = { radius + Random(seed) * (side - 2.0f * radius), radius + Random(seed) * (side - 2.0f * radius) };
+		Vector2 velocity = Vector2Rotate(Vector2UnitX, Random(seed) * 2.0f * PI) * (200.0f + Random(seed) * 400.0f);
+		AddCircle(sim, position, velocity, radius, 0.0f);
+	}
+}
+
+void BuildMixedRadiiScene(PhysicsSimulation& sim, int count)
+{
+	float width = 30.0f * sqrtf((float)count) + 400.0f;
+	AddBox(sim, 0.0f, width, 800.0f);
+
+	uint32_t seed = 3;
+	for (int i = 0; i < count; ++i)
+	{
+		// Mostly small circles with the odd large one
+		float t = Random(seed);
+		float radius = 2.0f + t * t * t * 38.0f;
+		Vector2 position = { radius + Random(seed) * (width - 2.0f * radius), 780.0f - Random(seed) * width };
+		AddCircle(sim, position, Vector2Zeros, radius);
+	}
+}
+
+const StressScene STRESS_SCENES[] = {
+	{ "funnel", BuildFunnelFillScene },
+	{ "rain", BuildRainScene },
+	{ "pyramid", BuildPyramidScene },
+	{ "swarm", BuildSwarmScene },
+	{ "mixed", BuildMixedRadiiScene },
+};
+const int STRESS_SCENE_COUNT = sizeof(STRESS_SCENES) / sizeof(STRESS_SCENES[0]);
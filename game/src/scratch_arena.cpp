@@ -0,0 +1,94 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+ScratchArena::AllocateFunction ScratchArena::allocate = malloc;
+ScratchArena::FreeFunction ScratchArena::release = free;
+
+void ScratchArena::SetAllocator(AllocateFunction allocateChunk, FreeFunction freeChunk)
+{
+	allocate = allocateChunk ? allocateChunk : malloc;
+	release = allocateChunk ? freeChunk : free;
+}
+
+void ScratchArena::AddChunk(size_t size)
+{
+	unsigned char* memory = (unsigned char*)allocate(size);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	chunks.push_back({ memory, size, release });
+}
+
+void* ScratchArena::Allocate(size_t bytes, size_t alignment)
+{
+	// Whatever is left at the end of a chunk that didn't fit goes unused until the next Reset()
+	for (; chunk < chunks.size(); chunk++)
+	{
+		uintptr_t base = (uintptr_t)chunks[chunk].memory;
+		size_t start = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+		if (start + bytes <= chunks[chunk].size)
+		{
+			offset = start + bytes;
+			highWaterMark = std::max(highWaterMark, Used());
+			return chunks[chunk].memory + start;
+		}
+		usedBefore += offset;
+		offset = 0;
+	}
+
+	AddChunk(std::max(CHUNK_SIZE, bytes + alignment));
+	return Allocate(bytes, alignment);
+}
+
+void ScratchArena::Reset()
+{
+	for (const std::unique_ptr<ScratchArena>& sub : subArenas)
+		sub->Reset();
+
+	// The last step didn't fit in one chunk, the next one will
+	if (chunks.size() > 1)
+	{
+		size_t total = Capacity();
+		Release();
+		AddChunk(total);
+	}
+	chunk = 0;
+	offset = 0;
+	usedBefore = 0;
+}
+
+void ScratchArena::Release()
+{
+	for (const std::unique_ptr<ScratchArena>& sub : subArenas)
+		sub->Release();
+
+	for (const Chunk& c : chunks)
+		c.release(c.memory);
+	chunks.clear();
+	chunk = 0;
+	offset = 0;
+	usedBefore = 0;
+}
+
+void ScratchArena::ReserveSubArenas(size_t count)
+{
+	while (subArenas.size() < count)
+		subArenas.emplace_back(new ScratchArena());
+}
+
+void ScratchArena::Rewind(const Mark& mark)
+{
+	chunk = mark.chunk;
+	offset = mark.offset;
+	usedBefore = mark.usedBefore;
+}
+
+size_t ScratchArena::Capacity() const
+{
+	size_t total = 0;
+	for (const Chunk& c : chunks)
+		total += c.size;
+	return total;
+}
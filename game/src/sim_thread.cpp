@@ -0,0 +1,170 @@
+#include "sim_thread.h"
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+
+void SimulationThread::Start(float stepsPerSecond)
+{
+	Stop();
+
+	stepDt = 1.0f / stepsPerSecond;
+	due = std::chrono::steady_clock::now();
+	lastDt = 0.0f;
+	Publish(); // Something to draw before the first step
+	running = true;
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	running = false;
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+	}
+	idleWake.notify_one();
+	thread.join();
+}
+
+void SimulationThread::Run()
+{
+	Profiler::RegisterThread(); // Not at the first step's zones
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point next = Clock::now();
+
+	while (running)
+	{
+		ApplyCommands();
+		if (replay && replay->IsOpen() && !replay->Apply(sim, launch) && replay->HasEndHash())
+			printf("Replay finished, state %s the recording\n", replay->Matches(sim) ? "matches" : "differs from");
+
+		float dt = sim.NextTimeStep(stepDt);
+		sim.Step(dt);
+		if (statsLog)
+			statsLog->Write(sim.lastStats);
+		if (trajectoryRecorder)
+			trajectoryRecorder->Record(sim);
+
+		{
+			PROFILE_ZONE("preview");
+			preview.Update(sim, launch.position, launch.Velocity(), launch.radius);
+		}
+
+		// Simulation time keeps level with the clock, but after a long stall start over from now rather than rush through the backlog
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(dt));
+		next += period;
+		Clock::time_point now = Clock::now();
+		if (now - next > period * 5)
+			next = now;
+
+		due = next;
+		lastDt = dt;
+		Publish();
+
+		if (idle)
+		{
+			WaitWhileIdle();
+			next = Clock::now(); // Time stood still while idle
+		}
+		else
+			std::this_thread::sleep_until(next);
+	}
+}
+
+void SimulationThread::WaitWhileIdle()
+{
+	std::unique_lock<std::mutex> lock(idleMutex);
+	idleWake.wait(lock, [this] { return !commands.Empty() || !running; });
+}
+
+bool SimulationThread::Send(const SimCommand& command)
+{
+	if (!commands.Push(command))
+		return false;
+	commandsSent++;
+
+	// Through the mutex, or the wake could land between the thread checking the queue and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+	}
+	idleWake.notify_one();
+	return true;
+}
+
+void SimulationThread::ApplyCommands()
+{
+	bool replaying = replay && replay->IsOpen();
+
+	// Recorded here rather than when sent, so the step stamped on each input is the one it really precedes
+	SimCommand command;
+	while (commands.Pop(command))
+	{
+		commandsApplied++;
+		if (command.type == SIM_COMMAND_POINTER)
+		{
+			pointer = command.point;
+			continue;
+		}
+		if (replaying)
+			continue;
+
+		LaunchControls before = launch;
+		switch (command.type)
+		{
+		case SIM_COMMAND_KEY:
+			if (inputRecorder)
+				inputRecorder->RecordKey(sim, command.key);
+			ApplyLaunchKey(launch, sim, command.key);
+			break;
+		case SIM_COMMAND_LAUNCH_ANGLE: launch.angle = command.value; break;
+		case SIM_COMMAND_LAUNCH_SPEED: launch.speed = command.value; break;
+		case SIM_COMMAND_LAUNCH_X: launch.position.x = command.value; break;
+		default: break;
+		}
+
+		if (inputRecorder && command.type != SIM_COMMAND_KEY)
+			inputRecorder->RecordChanges(sim, before, launch);
+	}
+}
+
+void SimulationThread::Publish()
+{
+	RenderSnapshot& snapshot = snapshots.Back();
+	snapshot.step = sim.StepCount();
+	snapshot.stats = sim.lastStats;
+	snapshot.due = due;
+	snapshot.stepDt = lastDt;
+	for (int i = 0; i < sim.QualityTier(); ++i)
+		snapshot.degradations[i] = sim.budget.order[i];
+	snapshot.launch = launch;
+	snapshot.replaying = replay && replay->IsOpen();
+	idle = sim.lastStats.activeBodies == 0 && !snapshot.replaying;
+	snapshot.idle = idle;
+	snapshot.commandsApplied = commandsApplied;
+
+	const std::vector<Vector2>& starts = sim.StepStartPositions();
+	snapshot.bodies.resize(sim.objects.size());
+	for (size_t i = 0; i < sim.objects.size(); ++i)
+	{
+		const PhysicsBody& o = sim.objects[i];
+		RenderBody& b = snapshot.bodies[i];
+		b.position = o.position;
+		b.previousPosition = i < starts.size() ? starts[i] : o.position;
+		b.normal = o.colliderType == COLLIDER_TYPE_HALF_SPACE ? sim.details[i].normal : Vector2Zeros;
+		b.radius = o.colliderType == COLLIDER_TYPE_CIRCLE ? o.radius : 0.0f;
+		b.color = sim.details[i].color;
+		b.colliderType = (ColliderType)o.colliderType;
+		b.collision = o.collision;
+	}
+
+	snapshot.previewPoints = preview.points;
+	snapshot.previewHit = preview.hit;
+
+	int hovered[8];
+	int hoveredCount = sim.QueryPoint(pointer, hovered, 8);
+	snapshot.hovered.assign(hovered, hovered + hoveredCount);
+
+	snapshots.Publish();
+}
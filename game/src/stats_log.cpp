@@ -0,0 +1,89 @@
+#include "stats_log.h"
+#include <cstring>
+
+static_assert(sizeof(PhysicsStepStats) == 80, "Add the new field to the CSV columns, StatsLog::Write() and STATS_LOG_RECORD_SIZE");
+
+bool StatsLog::Open(const char* path, float timeStep)
+{
+	size_t length = strlen(path);
+	bool csv = length >= 4 && strcmp(path + length - 4, ".csv") == 0;
+	return Open(path, timeStep, csv ? STATS_LOG_FORMAT_CSV : STATS_LOG_FORMAT_BINARY);
+}
+
+bool StatsLog::Open(const char* path, float timeStep, StatsLogFormat logFormat)
+{
+	Close();
+
+	file = fopen(path, logFormat == STATS_LOG_FORMAT_CSV ? "w" : "wb");
+	if (!file)
+		return false;
+
+	format = logFormat;
+	recordCount = 0;
+
+	if (format == STATS_LOG_FORMAT_CSV)
+	{
+		fprintf(file, "step,time,dt,active,sleeping,static,reduced_rate,candidate_pairs,narrowphase_tests,narrowphase_hits,"
+			"contacts_resolved,broadphase_efficiency,spawned,culled,reordered,scratch_bytes,quality_tier,step_cost_ms\n");
+	}
+	else
+	{
+		StatsLogHeader header;
+		header.timeStep = timeStep;
+		fwrite(&header, sizeof(header), 1, file);
+	}
+	return true;
+}
+
+void StatsLog::Close()
+{
+	if (file)
+		fclose(file);
+	file = nullptr;
+}
+
+void StatsLog::Write(const PhysicsStepStats& stats)
+{
+	if (!file)
+		return;
+
+	if (format == STATS_LOG_FORMAT_CSV)
+	{
+		fprintf(file, "%llu,%.4f,%.5f,%d,%d,%d,%d,%d,%d,%d,%d,%.4f,%d,%d,%d,%d,%d,%.3f\n", (unsigned long long)stats.step, stats.time, stats.stepDt,
+			stats.activeBodies, stats.sleepingBodies, stats.staticBodies, stats.reducedRateBodies, stats.candidatePairs, stats.narrowphaseTests,
+			stats.narrowphaseHits, stats.contactsResolved, stats.broadphaseEfficiency, stats.bodiesSpawned, stats.bodiesCulled, stats.bodiesReordered, stats.scratchBytes,
+			stats.qualityTier, stats.stepCostMs);
+	}
+	else
+	{
+		// Field by field, the struct's padding would put stack garbage in the file
+		unsigned char record[STATS_LOG_RECORD_SIZE];
+		unsigned char* out = record;
+		auto put = [&](const auto& value)
+		{
+			memcpy(out, &value, sizeof(value));
+			out += sizeof(value);
+		};
+		put(stats.step);
+		put(stats.activeBodies);
+		put(stats.sleepingBodies);
+		put(stats.staticBodies);
+		put(stats.reducedRateBodies);
+		put(stats.candidatePairs);
+		put(stats.narrowphaseTests);
+		put(stats.narrowphaseHits);
+		put(stats.contactsResolved);
+		put(stats.broadphaseEfficiency);
+		put(stats.stepDt);
+		put(stats.time);
+		put(stats.bodiesSpawned);
+		put(stats.bodiesCulled);
+		put(stats.bodiesReordered);
+		put(stats.scratchBytes);
+		put(stats.qualityTier);
+		put(stats.stepCostMs);
+		fwrite(record, sizeof(record), 1, file);
+	}
+
+	recordCount++;
+}
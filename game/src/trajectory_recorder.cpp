@@ -0,0 +1,343 @@
+#include "trajectory_recorder.h"
+#include "deflate.h"
+#include <cstring>
+
+// Chunk data is a run of frames, each frame holds position.x, position.y, velocity.x, velocity.y per body
+static const int VALUES_PER_BODY = 4;
+
+static bool SeekFile(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Groups byte k of every value together before deflating, the mostly zero high bytes of the XORed values
+// then form long runs instead of being scattered between the noisy low bytes
+static void SplitBytePlanes(const std::vector<unsigned char>& in, std::vector<unsigned char>& out)
+{
+	size_t count = in.size() / sizeof(int32_t);
+	out.resize(in.size());
+	for (size_t i = 0; i < count; ++i)
+		for (size_t b = 0; b < sizeof(int32_t); ++b)
+			out[b * count + i] = in[i * sizeof(int32_t) + b];
+}
+
+static void JoinBytePlanes(const std::vector<unsigned char>& in, std::vector<unsigned char>& out)
+{
+	size_t count = in.size() / sizeof(int32_t);
+	out.resize(in.size());
+	for (size_t i = 0; i < count; ++i)
+		for (size_t b = 0; b < sizeof(int32_t); ++b)
+			out[i * sizeof(int32_t) + b] = in[b * count + i];
+}
+
+static int32_t Quantize(float v, float inverseQuantization)
+{
+	return (int32_t)std::floor(v * inverseQuantization + 0.5f);
+}
+
+bool TrajectoryRecorder::Open(const char* path, float timeStep, int interval, float quantization)
+{
+	Close();
+
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	TrajectoryFileHeader header;
+	header.timeStep = timeStep;
+	header.quantization = quantization;
+	fwrite(&header, sizeof(header), 1, file);
+
+	keyframeInterval = interval > 0 ? interval : 1;
+	inverseQuantization = 1.0f / quantization;
+	recordedSteps = 0;
+	current.header = TrajectoryChunkHeader();
+	current.data.clear();
+
+	index.clear();
+	stalledChunks = 0;
+	rawBytes = 0;
+	compressedBytes = 0;
+	stopping = false;
+	worker = std::thread(&TrajectoryRecorder::WorkerLoop, this);
+	return true;
+}
+
+void TrajectoryRecorder::Close()
+{
+	if (!file)
+		return;
+
+	FlushChunk();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+
+	// The worker appended every chunk, so the index goes right after the last one
+	TrajectoryFileFooter footer;
+	footer.indexOffset = fileOffset;
+	footer.chunkCount = (uint32_t)index.size();
+	if (!index.empty())
+		fwrite(index.data(), sizeof(TrajectoryIndexEntry), index.size(), file);
+	fwrite(&footer, sizeof(footer), 1, file);
+
+	fclose(file);
+	file = nullptr;
+	spareBuffers.clear();
+}
+
+void TrajectoryRecorder::Record(const PhysicsSimulation& sim)
+{
+	if (!file)
+		return;
+
+	uint32_t bodyCount = (uint32_t)sim.objects.size();
+	TrajectoryChunkHeader& chunk = current.header;
+
+	// Start a new chunk every keyframeInterval steps, and whenever the XOR against the last step wouldn't line up
+	if (chunk.stepCount > 0 && (chunk.stepCount >= (uint32_t)keyframeInterval || chunk.bodyCount != bodyCount ||
+		chunk.firstStep + chunk.stepCount != sim.StepCount() || sim.lastStats.bodiesReordered > 0))
+		FlushChunk();
+
+	if (chunk.stepCount == 0)
+	{
+		chunk.firstStep = sim.StepCount();
+		chunk.bodyCount = bodyCount;
+		current.data.clear();
+
+		// XOR against zero, so the first frame is the keyframe
+		previous.assign((size_t)bodyCount * VALUES_PER_BODY, 0);
+	}
+
+	size_t offset = current.data.size();
+	current.data.resize(offset + previous.size() * sizeof(int32_t));
+	unsigned char* out = current.data.data() + offset;
+
+	int32_t* last = previous.data();
+	for (const PhysicsBody& o : sim.objects)
+	{
+		int32_t values[VALUES_PER_BODY] = {
+			Quantize(o.position.x, inverseQuantization), Quantize(o.position.y, inverseQuantization),
+			Quantize(o.velocity.x, inverseQuantization), Quantize(o.velocity.y, inverseQuantization) };
+
+		int32_t delta[VALUES_PER_BODY];
+		for (int k = 0; k < VALUES_PER_BODY; ++k)
+		{
+			delta[k] = values[k] ^ last[k];
+			last[k] = values[k];
+		}
+
+		memcpy(out, delta, sizeof(delta));
+		out += sizeof(delta);
+		last += VALUES_PER_BODY;
+	}
+
+	chunk.stepCount++;
+	recordedSteps++;
+}
+
+uint64_t TrajectoryRecorder::RawBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return rawBytes;
+}
+
+uint64_t TrajectoryRecorder::CompressedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return compressedBytes;
+}
+
+uint64_t TrajectoryRecorder::StalledChunks() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stalledChunks;
+}
+
+void TrajectoryRecorder::FlushChunk()
+{
+	if (current.header.stepCount == 0)
+		return;
+
+	current.header.rawSize = (uint32_t)current.data.size();
+	current.header.compressedSize = 0;
+	{
+		// Wait rather than drop: a missing chunk would leave a hole in the recording
+		std::unique_lock<std::mutex> lock(mutex);
+		if (pending.size() >= MAX_PENDING_CHUNKS)
+		{
+			if (stalledChunks++ == 0)
+				printf("Trajectory recorder: compression is falling behind, recording waits for it\n");
+			drained.wait(lock, [this] { return pending.size() < MAX_PENDING_CHUNKS; });
+		}
+		pending.push_back(std::move(current));
+
+		// Reuse a buffer the worker has finished with so recording doesn't allocate once it's warmed up
+		current.data.clear();
+		if (!spareBuffers.empty())
+		{
+			current.data = std::move(spareBuffers.back());
+			spareBuffers.pop_back();
+		}
+	}
+	wake.notify_one();
+	current.header = TrajectoryChunkHeader();
+}
+
+void TrajectoryRecorder::WorkerLoop()
+{
+	fileOffset = sizeof(TrajectoryFileHeader);
+	for (;;)
+	{
+		Chunk chunk;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !pending.empty(); });
+			if (pending.empty())
+				return;
+
+			chunk = std::move(pending.front());
+			pending.pop_front();
+		}
+		drained.notify_one();
+
+		// compressedSize = 0 marks a chunk stored as is
+		SplitBytePlanes(chunk.data, planes);
+		const unsigned char* bytes = planes.data();
+		if (DeflateBytes(planes.data(), (int)planes.size(), compressed) && compressed.size() < planes.size())
+		{
+			chunk.header.compressedSize = (uint32_t)compressed.size();
+			bytes = compressed.data();
+		}
+		size_t size = chunk.header.compressedSize > 0 ? chunk.header.compressedSize : chunk.header.rawSize;
+
+		fwrite(&chunk.header, sizeof(chunk.header), 1, file);
+		fwrite(bytes, 1, size, file);
+		index.push_back({ chunk.header.firstStep, chunk.header.stepCount, chunk.header.bodyCount, fileOffset });
+		fileOffset += sizeof(chunk.header) + size;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		rawBytes += chunk.header.rawSize;
+		compressedBytes += size;
+		if (spareBuffers.size() < 4)
+		{
+			chunk.data.clear();
+			spareBuffers.push_back(std::move(chunk.data));
+		}
+	}
+}
+
+bool TrajectoryReader::Open(const char* path)
+{
+	Close();
+
+	file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	TrajectoryFileFooter footer;
+	TrajectoryFileHeader expected;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+		header.version == expected.version;
+
+	ok = ok && fseek(file, -(long)sizeof(footer), SEEK_END) == 0 && fread(&footer, sizeof(footer), 1, file) == 1 &&
+		memcmp(footer.magic, TrajectoryFileFooter().magic, sizeof(footer.magic)) == 0;
+
+	if (ok)
+	{
+		index.resize(footer.chunkCount);
+		ok = SeekFile(file, footer.indexOffset) &&
+			fread(index.data(), sizeof(TrajectoryIndexEntry), index.size(), file) == index.size();
+	}
+
+	if (!ok)
+		Close();
+	return ok;
+}
+
+void TrajectoryReader::Close()
+{
+	if (file)
+		fclose(file);
+	file = nullptr;
+	index.clear();
+	loadedChunk = -1;
+}
+
+bool TrajectoryReader::Seek(uint64_t step, std::vector<TrajectorySample>& samples)
+{
+	// Last chunk starting at or before step
+	auto it = std::upper_bound(index.begin(), index.end(), step,
+		[](uint64_t s, const TrajectoryIndexEntry& e) { return s < e.firstStep; });
+	if (it == index.begin())
+		return false;
+	--it;
+	if (step >= it->firstStep + it->stepCount)
+		return false;
+
+	int chunk = (int)(it - index.begin());
+	if (chunk != loadedChunk && !LoadChunk(chunk))
+		return false;
+
+	float quantization = header.quantization;
+	size_t frameValues = (size_t)it->bodyCount * VALUES_PER_BODY;
+	const unsigned char* in = raw.data() + (step - it->firstStep) * frameValues * sizeof(int32_t);
+
+	samples.resize(it->bodyCount);
+	for (TrajectorySample& sample : samples)
+	{
+		int32_t values[VALUES_PER_BODY];
+		memcpy(values, in, sizeof(values));
+		in += sizeof(values);
+
+		sample.position = { values[0] * quantization, values[1] * quantization };
+		sample.velocity = { values[2] * quantization, values[3] * quantization };
+	}
+	return true;
+}
+
+bool TrajectoryReader::LoadChunk(int chunk)
+{
+	loadedChunk = -1;
+
+	TrajectoryChunkHeader chunkHeader;
+	if (!SeekFile(file, index[chunk].offset) || fread(&chunkHeader, sizeof(chunkHeader), 1, file) != 1)
+		return false;
+
+	planes.resize(chunkHeader.rawSize);
+	if (chunkHeader.compressedSize == 0)
+	{
+		if (fread(planes.data(), 1, planes.size(), file) != planes.size())
+			return false;
+	}
+	else
+	{
+		compressed.resize(chunkHeader.compressedSize);
+		if (fread(compressed.data(), 1, compressed.size(), file) != compressed.size() ||
+			!InflateBytes(compressed.data(), (int)compressed.size(), planes))
+			return false;
+	}
+	JoinBytePlanes(planes, raw);
+
+	// Undo the XOR chain once for the whole chunk, every frame then reads directly
+	size_t frameBytes = (size_t)chunkHeader.bodyCount * VALUES_PER_BODY * sizeof(int32_t);
+	for (size_t at = frameBytes; at + frameBytes <= raw.size(); at += frameBytes)
+		for (size_t v = 0; v < frameBytes; v += sizeof(int32_t))
+		{
+			int32_t value, before;
+			memcpy(&value, &raw[at + v], sizeof(value));
+			memcpy(&before, &raw[at - frameBytes + v], sizeof(before));
+			value ^= before;
+			memcpy(&raw[at + v], &value, sizeof(value));
+		}
+
+	loadedChunk = chunk;
+	return true;
+}
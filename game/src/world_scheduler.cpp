@@ -0,0 +1,140 @@
+#include "world_scheduler.h"
+#include "profiler.h"
+#include <chrono>
+
+WorldScheduler::WorldScheduler(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (int i = 0; i < threadCount; ++i)
+		workers.push_back(std::make_unique<Worker>());
+	for (int i = 0; i < threadCount; ++i)
+		workers[i]->thread = std::thread(&WorldScheduler::WorkerLoop, this, i);
+}
+
+WorldScheduler::~WorldScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::unique_ptr<Worker>& worker : workers)
+		worker->thread.join();
+}
+
+int WorldScheduler::AddWorld(const PhysicsSimulation& sim)
+{
+	worlds.push_back(std::make_unique<World>());
+	worlds.back()->sim = sim;
+	return (int)worlds.size() - 1;
+}
+
+void WorldScheduler::Step(int steps)
+{
+	if (worlds.empty())
+		return;
+
+	stepsPerTask = steps;
+	pending.store((int)worlds.size());
+
+	// Deal the worlds out round-robin, stealing evens out whatever imbalance is left
+	for (int i = 0; i < (int)worlds.size(); ++i)
+	{
+		Worker& worker = *workers[i % workers.size()];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(i);
+	}
+
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	batch++;
+	wake.notify_all();
+	done.wait(lock, [&] { return pending.load() == 0; });
+}
+
+bool WorldScheduler::TakeTask(int self, int& task)
+{
+	{
+		Worker& own = *workers[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (int i = 1; i < (int)workers.size(); ++i)
+	{
+		Worker& victim = *workers[(self + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorldScheduler::RunTask(int task)
+{
+	World& world = *worlds[task];
+	PhysicsSimulation& sim = world.sim;
+	WorldTiming& timing = world.timing;
+
+	for (int s = 0; s < stepsPerTask; ++s)
+	{
+		auto start = std::chrono::steady_clock::now();
+		sim.Step(1.0f / sim.TARGET_FPS);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		timing.steps++;
+		timing.lastMs = ms;
+		timing.averageMs += (ms - timing.averageMs) / timing.steps;
+		timing.maxMs = std::max(timing.maxMs, ms);
+	}
+
+	WorldSnapshot& snapshot = world.snapshots.Back();
+	snapshot.step = timing.steps;
+	snapshot.bodies = sim.objects;
+	world.snapshots.Publish();
+}
+
+void WorldScheduler::WorkerLoop(int self)
+{
+	Profiler::RegisterThread(); // Not at the first step's zones
+	uint64_t seenBatch = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [&] { return stopping || batch != seenBatch; });
+			if (stopping)
+				return;
+			seenBatch = batch;
+		}
+
+		int task;
+		while (TakeTask(self, task))
+		{
+			RunTask(task);
+			if (pending.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				done.notify_all();
+			}
+		}
+	}
+}
+
+const WorldSnapshot& WorldScheduler::LatestSnapshot(int id)
+{
+	TripleBuffer<WorldSnapshot>& snapshots = worlds[id]->snapshots;
+	snapshots.Acquire();
+	return snapshots.Front();
+}
@@ -0,0 +1,364 @@
+#include "world_streamer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Saved chunk: header, then count records
+struct ChunkFileHeader
+{
+	char magic[4] = { 'P', 'C', 'H', 'K' };
+	uint32_t version = 2;
+	int32_t x = 0, y = 0;
+	uint32_t count = 0;
+};
+
+// One circle, position relative to the chunk's corner
+struct ChunkRecord
+{
+	Vector2 position;
+	Vector2 velocity;
+	float radius;
+	float gravityScale;
+	float drag;
+	Color color;
+	uint8_t forceGroups;
+	uint8_t spare[3]; // Written as 0, records are copied byte for byte
+};
+
+static_assert(sizeof(ChunkRecord) == 36, "No padding in saved chunks");
+
+static void WriteChunk(const ChunkFileHeader& header, const std::vector<PhysicsBodyDef>& bodies, std::vector<unsigned char>& out)
+{
+	out.resize(sizeof(header) + bodies.size() * sizeof(ChunkRecord));
+	memcpy(out.data(), &header, sizeof(header));
+
+	ChunkRecord* records = (ChunkRecord*)(out.data() + sizeof(header));
+	for (size_t i = 0; i < bodies.size(); ++i)
+	{
+		const PhysicsBodyDef& def = bodies[i];
+		records[i] = { def.position, def.velocity, def.collider.circle.radius, def.gravityScale, def.drag, def.color, def.forceGroups, {} };
+	}
+}
+
+static bool ReadChunk(const std::vector<unsigned char>& in, ChunkCoord coord, std::vector<PhysicsBodyDef>& bodies)
+{
+	ChunkFileHeader header, expected;
+	if (in.size() < sizeof(header))
+		return false;
+	memcpy(&header, in.data(), sizeof(header));
+	if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+		header.x != coord.x || header.y != coord.y || in.size() != sizeof(header) + header.count * sizeof(ChunkRecord))
+		return false;
+
+	const ChunkRecord* records = (const ChunkRecord*)(in.data() + sizeof(header));
+	bodies.resize(header.count);
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		PhysicsBodyDef& def = bodies[i];
+		def = PhysicsBodyDef();
+		def.position = records[i].position;
+		def.velocity = records[i].velocity;
+		def.gravityScale = records[i].gravityScale;
+		def.drag = records[i].drag;
+		def.color = records[i].color;
+		def.forceGroups = records[i].forceGroups;
+		def.colliderType = COLLIDER_TYPE_CIRCLE;
+		def.collider.circle.radius = records[i].radius;
+	}
+	return true;
+}
+
+WorldStreamer::WorldStreamer(const WorldStreamingSettings& s)
+	: settings(s), inverseChunkSize(1.0f / s.chunkSize)
+{
+	worker = std::thread(&WorldStreamer::WorkerLoop, this);
+}
+
+WorldStreamer::~WorldStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+Vector2 WorldStreamer::Corner(ChunkCoord chunk) const
+{
+	return { (chunk.x - origin.x) * settings.chunkSize, (chunk.y - origin.y) * settings.chunkSize };
+}
+
+Vector2 WorldStreamer::ToSimulation(ChunkCoord chunk, Vector2 local) const
+{
+	return Corner(chunk) + local;
+}
+
+ChunkCoord WorldStreamer::ChunkAt(Vector2 position) const
+{
+	return { (int)std::floor(position.x * inverseChunkSize) + origin.x, (int)std::floor(position.y * inverseChunkSize) + origin.y };
+}
+
+Vector2 WorldStreamer::Update(PhysicsSimulation& sim, Vector2 camera)
+{
+	// Chunks the worker finished loading start out asleep
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Job& job : loaded)
+		{
+			Chunk& chunk = chunks[Key(job.coord)];
+			chunk.state = CHUNK_SLEEPING;
+			chunk.bodies = std::move(job.bodies);
+			stats.loads++;
+		}
+		loaded.clear();
+	}
+
+	// Floating origin, in whole chunks so chunk corners stay on round numbers
+	Vector2 shift = Vector2Zeros;
+	ChunkCoord center = ChunkAt(camera);
+	ChunkCoord fromOrigin = { center.x - origin.x, center.y - origin.y };
+	if (Distance(fromOrigin, { 0, 0 }) > settings.rebaseDistance)
+	{
+		shift = { fromOrigin.x * settings.chunkSize, fromOrigin.y * settings.chunkSize };
+		sim.ShiftOrigin(shift);
+		origin = center;
+		stats.rebases++;
+	}
+
+	for (int y = center.y - settings.loadRadius; y <= center.y + settings.loadRadius; ++y)
+		for (int x = center.x - settings.loadRadius; x <= center.x + settings.loadRadius; ++x)
+			if (chunks.find(Key({ x, y })) == chunks.end())
+				RequestLoad({ x, y });
+
+	for (auto& entry : chunks)
+	{
+		Chunk& chunk = entry.second;
+		int distance = Distance(chunk.coord, center);
+		if (chunk.state == CHUNK_SLEEPING && distance <= settings.activeRadius)
+			Activate(sim, chunk);
+		else if (chunk.state == CHUNK_ACTIVE && distance > settings.activeRadius + 1)
+			chunk.state = CHUNK_SLEEPING; // Its bodies are collected below
+	}
+
+	CollectLeavingBodies(sim, center);
+
+	stats.activeChunks = stats.sleepingChunks = stats.loadingChunks = stats.sleepingBodies = 0;
+	for (auto it = chunks.begin(); it != chunks.end();)
+	{
+		Chunk& chunk = it->second;
+		if (chunk.state == CHUNK_SLEEPING && Distance(chunk.coord, center) > settings.loadRadius + 1)
+		{
+			RequestSave(chunk);
+			it = chunks.erase(it);
+			stats.unloads++;
+			continue;
+		}
+
+		if (chunk.state == CHUNK_ACTIVE)
+			stats.activeChunks++;
+		else if (chunk.state == CHUNK_SLEEPING)
+		{
+			stats.sleepingChunks++;
+			stats.sleepingBodies += (int)chunk.bodies.size();
+		}
+		else
+			stats.loadingChunks++;
+		++it;
+	}
+	return shift;
+}
+
+Vector2 WorldStreamer::WaitForActive(PhysicsSimulation& sim, Vector2 camera)
+{
+	Vector2 shift = Update(sim, camera);
+	while (!ActiveAround(ChunkAt(camera - shift)))
+	{
+		// Update() requested every missing chunk, they come back in order
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [this] { return !loaded.empty(); });
+		}
+		shift += Update(sim, camera - shift);
+	}
+	return shift;
+}
+
+bool WorldStreamer::ActiveAround(ChunkCoord center) const
+{
+	for (int y = center.y - settings.activeRadius; y <= center.y + settings.activeRadius; ++y)
+		for (int x = center.x - settings.activeRadius; x <= center.x + settings.activeRadius; ++x)
+		{
+			auto found = chunks.find(Key({ x, y }));
+			if (found == chunks.end() || found->second.state != CHUNK_ACTIVE)
+				return false;
+		}
+	return true;
+}
+
+void WorldStreamer::Activate(PhysicsSimulation& sim, Chunk& chunk)
+{
+	Vector2 corner = Corner(chunk.coord);
+	for (PhysicsBodyDef& def : chunk.bodies)
+	{
+		def.position += corner;
+		sim.AddBody(def);
+	}
+	chunk.bodies.clear();
+	chunk.state = CHUNK_ACTIVE;
+}
+
+// Circles that ended up in sleeping chunks go to sleep with them. A circle that wandered into a chunk
+// that isn't loaded stays in the simulation until the chunk is, so it's saved along with what's there.
+void WorldStreamer::CollectLeavingBodies(PhysicsSimulation& sim, ChunkCoord center)
+{
+	leaving.clear();
+	for (int i = 0; i < (int)sim.objects.size(); ++i)
+	{
+		const PhysicsBody& o = sim.objects[i];
+		if (o.colliderType != COLLIDER_TYPE_CIRCLE)
+			continue;
+
+		// Chunks this close are active or on their way, most bodies stop here without a lookup
+		ChunkCoord coord = ChunkAt(o.position);
+		if (Distance(coord, center) <= settings.activeRadius)
+			continue;
+
+		auto found = chunks.find(Key(coord));
+		if (found == chunks.end())
+		{
+			RequestLoad(coord);
+			continue;
+		}
+
+		Chunk& chunk = found->second;
+		if (chunk.state != CHUNK_SLEEPING)
+			continue;
+
+		PhysicsBodyDef def = sim.BodyDef(i);
+		def.position -= Corner(coord);
+		chunk.bodies.push_back(def);
+		leaving.push_back(i);
+	}
+
+	if (!leaving.empty())
+		sim.RemoveBodies(leaving.data(), (int)leaving.size());
+}
+
+void WorldStreamer::RequestLoad(ChunkCoord coord)
+{
+	Chunk& chunk = chunks[Key(coord)];
+	chunk.coord = coord;
+	chunk.state = CHUNK_LOADING;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back({ coord, false, {} });
+	}
+	wake.notify_one();
+}
+
+void WorldStreamer::RequestSave(Chunk& chunk)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back({ chunk.coord, true, std::move(chunk.bodies) });
+	}
+	wake.notify_one();
+}
+
+void WorldStreamer::WorkerLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !requests.empty(); });
+			if (requests.empty())
+				return;
+
+			job = std::move(requests.front());
+			requests.pop_front();
+
+			// Nobody will pick up loads anymore, but every save is written
+			if (stopping && !job.save)
+				continue;
+		}
+
+		if (job.save)
+			Save(job);
+		else
+		{
+			Load(job);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				loaded.push_back(std::move(job));
+			}
+			finished.notify_one();
+		}
+	}
+}
+
+std::string WorldStreamer::ChunkPath(ChunkCoord coord) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "chunk_%d_%d.bin", coord.x, coord.y);
+	return settings.directory + "/" + name;
+}
+
+void WorldStreamer::Load(Job& job)
+{
+	std::vector<unsigned char> data;
+	bool saved = false;
+	if (settings.directory.empty())
+	{
+		auto found = stored.find(Key(job.coord));
+		if (found != stored.end())
+		{
+			data = std::move(found->second);
+			stored.erase(found);
+			saved = true;
+		}
+	}
+	else if (FILE* file = fopen(ChunkPath(job.coord).c_str(), "rb"))
+	{
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(size > 0 ? (size_t)size : 0);
+		saved = fread(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+	}
+
+	if (saved && ReadChunk(data, job.coord, job.bodies))
+		return;
+	if (saved)
+		printf("World streamer: chunk %d,%d is damaged, generating it again\n", job.coord.x, job.coord.y);
+
+	job.bodies.clear();
+	if (settings.generate)
+		settings.generate(job.coord, job.bodies);
+}
+
+void WorldStreamer::Save(const Job& job)
+{
+	ChunkFileHeader header;
+	header.x = job.coord.x;
+	header.y = job.coord.y;
+	header.count = (uint32_t)job.bodies.size();
+
+	if (settings.directory.empty())
+	{
+		WriteChunk(header, job.bodies, stored[Key(job.coord)]);
+		return;
+	}
+
+	std::vector<unsigned char> data;
+	WriteChunk(header, job.bodies, data);
+	FILE* file = fopen(ChunkPath(job.coord).c_str(), "wb");
+	if (!file || fwrite(data.data(), 1, data.size(), file) != data.size())
+		printf("World streamer: couldn't save chunk %d,%d to %s\n", job.coord.x, job.coord.y, settings.directory.c_str());
+	if (file)
+		fclose(file);
+}
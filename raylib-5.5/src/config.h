@@ -66,6 +66,10 @@
 #define SUPPORT_COMPRESSION_API         1
 // Support automatic generated events, loading and recording of those events when required
 #define SUPPORT_AUTOMATION_EVENTS       1
+// Count allocations by subsystem (MEMORY_TAG_*): per frame stats with GetMemoryTagStats(), leaks reported on CloseWindow()
+// Also allows custom allocators per subsystem with SetMemoryAllocator()
+// WARNING: Every allocation and free takes a lock and a hash table lookup, enable it for debugging only
+//#define SUPPORT_MEMORY_TRACKING         1
 // Support custom frame control, only for advanced users
 // By default EndDrawing() does this job: draws everything + SwapScreenBuffer() + manage frame timing + PollInputEvents()
 // Enabling this flag allows manual control of the frame processes, use at your own risk
@@ -91,6 +95,9 @@
 
 #define MAX_AUTOMATION_EVENTS       16384       // Maximum number of automation events to record
 
+#define MAX_MEMORY_ALLOCATORS          16       // Maximum number of custom allocators set with SetMemoryAllocator()
+#define MAX_MEMORY_LEAKS_REPORTED      16       // Maximum number of leaked blocks listed on CloseWindow()
+
 //------------------------------------------------------------------------------------
 // Module: rlgl - Configuration values
 //------------------------------------------------------------------------------------
@@ -78,6 +78,7 @@
     #if !defined(EXTERNAL_CONFIG_FLAGS)
         #include "config.h"     // Defines module configuration flags
     #endif
+    #define RL_MEMORY_TAG MEMORY_TAG_AUDIO   // Allocations counted under this tag (SUPPORT_MEMORY_TRACKING)
     #include "utils.h"          // Required for: fopen() Android mapping
 #endif
 
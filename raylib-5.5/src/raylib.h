@@ -532,6 +532,17 @@ typedef struct AutomationEventList {
     AutomationEvent *events;        // Events entries
 } AutomationEventList;
 
+// Memory tag stats, allocations counted by the subsystem that made them
+// NOTE: Requires SUPPORT_MEMORY_TRACKING, otherwise everything stays 0
+typedef struct MemoryTagStats {
+    unsigned int frameAllocCount;   // Allocations (and reallocations) during the last frame
+    unsigned int frameFreeCount;    // Frees during the last frame
+    unsigned long long frameAllocBytes; // Bytes allocated during the last frame
+    unsigned int liveCount;         // Blocks currently allocated
+    unsigned long long liveBytes;   // Bytes currently allocated
+    unsigned long long peakBytes;   // Most bytes allocated at once
+} MemoryTagStats;
+
 //----------------------------------------------------------------------------------
 // Enumerators Definition
 //----------------------------------------------------------------------------------
@@ -943,6 +954,19 @@ typedef enum {
     NPATCH_THREE_PATCH_HORIZONTAL   // Npatch layout: 3x1 tiles
 } NPatchLayout;
 
+// Memory tags, the subsystem an allocation is counted under
+typedef enum {
+    MEMORY_TAG_CORE = 0,            // Memory tag: rcore, platform and file loading
+    MEMORY_TAG_RLGL,                // Memory tag: rlgl render batch and shaders
+    MEMORY_TAG_TEXTURES,            // Memory tag: rtextures images and textures
+    MEMORY_TAG_TEXT,                // Memory tag: rtext fonts and text
+    MEMORY_TAG_MODELS,              // Memory tag: rmodels meshes, materials and animations
+    MEMORY_TAG_AUDIO,               // Memory tag: raudio waves, sounds and music
+    MEMORY_TAG_USER,                // Memory tag: MemAlloc() and MemRealloc()
+    MEMORY_TAG_PHYSICS,             // Memory tag: game physics, through MemAllocTagged()
+    MEMORY_TAG_COUNT
+} MemoryTag;
+
 // Callbacks to hook some internal functions
 // WARNING: These callbacks are intended for advanced users
 typedef void (*TraceLogCallback)(int logLevel, const char *text, va_list args);  // Logging: Redirect trace log messages
@@ -951,6 +975,15 @@ typedef bool (*SaveFileDataCallback)(const char *fileName, void *data, int dataS
 typedef char *(*LoadFileTextCallback)(const char *fileName);            // FileIO: Load text data
 typedef bool (*SaveFileTextCallback)(const char *fileName, char *text); // FileIO: Save text data
 
+// Custom allocator for a memory tag, realloc can be NULL (alloc + copy + free)
+// WARNING: Allocators are intended for advanced users, calls are serialized by raylib
+typedef struct MemoryAllocator {
+    void *(*alloc)(void *user, unsigned int size);                  // Allocate size bytes, contents undefined
+    void *(*realloc)(void *user, void *ptr, unsigned int size);     // Resize a block from alloc
+    void (*free)(void *user, void *ptr);                            // Free a block from alloc
+    void *user;                                                     // Passed to every call
+} MemoryAllocator;
+
 //------------------------------------------------------------------------------------
 // Global Variables Definition
 //------------------------------------------------------------------------------------
@@ -1102,6 +1135,10 @@ RLAPI void SetTraceLogLevel(int logLevel);                        // Set the cur
 RLAPI void *MemAlloc(unsigned int size);                          // Internal memory allocator
 RLAPI void *MemRealloc(void *ptr, unsigned int size);             // Internal memory reallocator
 RLAPI void MemFree(void *ptr);                                    // Internal memory free
+RLAPI void *MemAllocTagged(unsigned int size, int tag);           // Internal memory allocator, counted under tag (MEMORY_TAG_*)
+RLAPI void *MemReallocTagged(void *ptr, unsigned int size, int tag); // Internal memory reallocator, counted under tag (MEMORY_TAG_*)
+RLAPI MemoryTagStats GetMemoryTagStats(int tag);                  // Get allocation stats of a memory tag (requires SUPPORT_MEMORY_TRACKING)
+RLAPI const char *GetMemoryTagName(int tag);                      // Get memory tag name
 
 // Set custom callbacks
 // WARNING: Callbacks setup is intended for advanced users
@@ -1110,6 +1147,7 @@ RLAPI void SetLoadFileDataCallback(LoadFileDataCallback callback); // Set custom
 RLAPI void SetSaveFileDataCallback(SaveFileDataCallback callback); // Set custom file binary data saver
 RLAPI void SetLoadFileTextCallback(LoadFileTextCallback callback); // Set custom file text data loader
 RLAPI void SetSaveFileTextCallback(SaveFileTextCallback callback); // Set custom file text data saver
+RLAPI void SetMemoryAllocator(int tag, MemoryAllocator allocator); // Set custom allocator for a memory tag (requires SUPPORT_MEMORY_TRACKING)
 
 // Files management functions
 RLAPI unsigned char *LoadFileData(const char *fileName, int *dataSize); // Load file data as byte array (read)
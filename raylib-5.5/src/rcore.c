@@ -111,7 +111,11 @@
 #include <math.h>                   // Required for: tan() [Used in BeginMode3D()], atan2f() [Used in LoadVrStereoConfig()]
 
 #define RLGL_IMPLEMENTATION
+#undef RL_MEMORY_TAG
+#define RL_MEMORY_TAG MEMORY_TAG_RLGL   // rlgl allocations counted apart from core (SUPPORT_MEMORY_TRACKING)
 #include "rlgl.h"                   // OpenGL abstraction layer to OpenGL 1.1, 3.3+ or ES2
+#undef RL_MEMORY_TAG
+#define RL_MEMORY_TAG MEMORY_TAG_CORE
 
 #define RAYMATH_IMPLEMENTATION
 #include "raymath.h"                // Vector2, Vector3, Quaternion and Matrix functionality
@@ -743,6 +747,10 @@ void CloseWindow(void)
 
     CORE.Window.ready = false;
     TRACELOG(LOG_INFO, "Window closed successfully");
+
+#if defined(SUPPORT_MEMORY_TRACKING)
+    TraceMemoryLeaks();     // Anything still allocated by now was never unloaded
+#endif
 }
 
 // Check if window has been initialized successfully
@@ -996,6 +1004,10 @@ void EndDrawing(void)
     }
 #endif  // SUPPORT_SCREEN_CAPTURE
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+    TrackMemoryFrame();     // Frame allocation counters restart with the next frame
+#endif
+
     CORE.Time.frameCounter++;
 }
 
@@ -49,6 +49,7 @@
 
 #if defined(SUPPORT_MODULE_RMODELS)
 
+#define RL_MEMORY_TAG MEMORY_TAG_MODELS   // Allocations counted under this tag (SUPPORT_MEMORY_TRACKING)
 #include "utils.h"          // Required for: TRACELOG(), LoadFileData(), LoadFileText(), SaveFileText()
 #include "rlgl.h"           // OpenGL abstraction layer to OpenGL 1.1, 2.1, 3.3+ or ES2
 #include "raymath.h"        // Required for: Vector3, Quaternion and Matrix functionality
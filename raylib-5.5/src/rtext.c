@@ -62,6 +62,7 @@
 
 #if defined(SUPPORT_MODULE_RTEXT)
 
+#define RL_MEMORY_TAG MEMORY_TAG_TEXT   // Allocations counted under this tag (SUPPORT_MEMORY_TRACKING)
 #include "utils.h"          // Required for: LoadFile*()
 #include "rlgl.h"           // OpenGL abstraction layer to OpenGL 1.1, 2.1, 3.3+ or ES2 -> Only DrawTextPro()
 
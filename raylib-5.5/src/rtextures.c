@@ -70,6 +70,7 @@
 
 #if defined(SUPPORT_MODULE_RTEXTURES)
 
+#define RL_MEMORY_TAG MEMORY_TAG_TEXTURES   // Allocations counted under this tag (SUPPORT_MEMORY_TRACKING)
 #include "utils.h"              // Required for: TRACELOG()
 #include "rlgl.h"               // OpenGL abstraction layer to multiple versions
 
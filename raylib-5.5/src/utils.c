@@ -49,12 +49,25 @@
 #include <stdarg.h>                     // Required for: va_list, va_start(), va_end()
 #include <string.h>                     // Required for: strcpy(), strcat()
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+    #include <stdint.h>                 // Required for: uintptr_t
+    #if defined(_MSC_VER)
+        #include <intrin.h>             // Required for: _InterlockedExchange()
+    #endif
+#endif
+
 //----------------------------------------------------------------------------------
 // Defines and Macros
 //----------------------------------------------------------------------------------
 #ifndef MAX_TRACELOG_MSG_LENGTH
     #define MAX_TRACELOG_MSG_LENGTH     256         // Max length of one trace-log message
 #endif
+#ifndef MAX_MEMORY_ALLOCATORS
+    #define MAX_MEMORY_ALLOCATORS        16         // Max custom allocators set over a run
+#endif
+#ifndef MAX_MEMORY_LEAKS_REPORTED
+    #define MAX_MEMORY_LEAKS_REPORTED    16         // Max leaked blocks listed on CloseWindow()
+#endif
 
 //----------------------------------------------------------------------------------
 // Global Variables Definition
@@ -67,6 +80,29 @@ static SaveFileDataCallback saveFileData = NULL;    // SaveFileText callback fun
 static LoadFileTextCallback loadFileText = NULL;    // LoadFileText callback function pointer
 static SaveFileTextCallback saveFileText = NULL;    // SaveFileText callback function pointer
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+// Live block, in an open addressing hash table keyed by address
+typedef struct MemoryBlock {
+    void *ptr;                                      // NULL if the slot is empty
+    size_t size;                                    // Bytes requested
+    unsigned char tag;                              // Memory tag it is counted under
+    unsigned char allocator;                        // Index into memAllocators, 0 for the C library
+} MemoryBlock;
+
+static MemoryBlock *memBlocks = NULL;               // Live blocks table
+static size_t memBlocksCapacity = 0;                // Table slots, power of two
+static size_t memBlocksCount = 0;                   // Table slots in use
+
+static MemoryAllocator memAllocators[MAX_MEMORY_ALLOCATORS] = { 0 };    // Custom allocators, [0] unused (C library)
+static int memAllocatorsCount = 1;
+static int memTagAllocator[MEMORY_TAG_COUNT] = { 0 };                   // Allocator index of every tag
+
+static MemoryTagStats memTagStats[MEMORY_TAG_COUNT] = { 0 };            // Frame counters of the frame in progress
+static MemoryTagStats memLastFrameStats[MEMORY_TAG_COUNT] = { 0 };      // Frame counters of the last finished frame
+
+static volatile long memLock = 0;                   // Spin lock, miniaudio allocates from the audio thread
+#endif
+
 //----------------------------------------------------------------------------------
 // Functions to set internal callbacks
 //----------------------------------------------------------------------------------
@@ -94,6 +130,15 @@ static fpos_t android_seek(void *cookie, fpos_t offset, int whence);
 static int android_close(void *cookie);
 #endif
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+static void LockMemory(void);                       // Lock the memory tracker
+static void UnlockMemory(void);                     // Unlock the memory tracker
+static MemoryBlock *FindMemoryBlock(void *ptr);     // Find the live block at ptr, NULL if untracked
+static bool ReserveMemoryBlock(void);              // Make room for one more live block, false if the table can't grow
+static void AddMemoryBlock(void *ptr, size_t size, int tag, int allocator); // Record a new live block and count it
+static void RemoveMemoryBlock(MemoryBlock *block);  // Forget a live block, the caller counts it
+#endif
+
 //----------------------------------------------------------------------------------
 // Module Functions Definition - Utilities
 //----------------------------------------------------------------------------------
@@ -161,15 +206,13 @@ void TraceLog(int logType, const char *text, ...)
 // NOTE: Initializes to zero by default
 void *MemAlloc(unsigned int size)
 {
-    void *ptr = RL_CALLOC(size, 1);
-    return ptr;
+    return MemAllocTagged(size, MEMORY_TAG_USER);
 }
 
 // Internal memory reallocator
 void *MemRealloc(void *ptr, unsigned int size)
 {
-    void *ret = RL_REALLOC(ptr, size);
-    return ret;
+    return MemReallocTagged(ptr, size, MEMORY_TAG_USER);
 }
 
 // Internal memory free
@@ -178,6 +221,101 @@ void MemFree(void *ptr)
     RL_FREE(ptr);
 }
 
+// Internal memory allocator, counted under tag
+// NOTE: Initializes to zero by default
+void *MemAllocTagged(unsigned int size, int tag)
+{
+#if defined(SUPPORT_MEMORY_TRACKING)
+    return TrackedAlloc(size, tag, 1);
+#else
+    (void)tag;
+    return RL_CALLOC(size, 1);
+#endif
+}
+
+// Internal memory reallocator, counted under tag
+void *MemReallocTagged(void *ptr, unsigned int size, int tag)
+{
+#if defined(SUPPORT_MEMORY_TRACKING)
+    return TrackedRealloc(ptr, size, tag);
+#else
+    (void)tag;
+    return RL_REALLOC(ptr, size);
+#endif
+}
+
+// Get memory tag name
+const char *GetMemoryTagName(int tag)
+{
+    switch (tag)
+    {
+        case MEMORY_TAG_CORE: return "core";
+        case MEMORY_TAG_RLGL: return "rlgl";
+        case MEMORY_TAG_TEXTURES: return "textures";
+        case MEMORY_TAG_TEXT: return "text";
+        case MEMORY_TAG_MODELS: return "models";
+        case MEMORY_TAG_AUDIO: return "audio";
+        case MEMORY_TAG_USER: return "user";
+        case MEMORY_TAG_PHYSICS: return "physics";
+        default: return "unknown";
+    }
+}
+
+// Get allocation stats of a memory tag
+// NOTE: Frame counters are the ones of the last frame finished by EndDrawing()
+MemoryTagStats GetMemoryTagStats(int tag)
+{
+    MemoryTagStats stats = { 0 };
+#if defined(SUPPORT_MEMORY_TRACKING)
+    if ((tag < 0) || (tag >= MEMORY_TAG_COUNT)) return stats;
+
+    LockMemory();
+    stats = memTagStats[tag];
+    stats.frameAllocCount = memLastFrameStats[tag].frameAllocCount;
+    stats.frameFreeCount = memLastFrameStats[tag].frameFreeCount;
+    stats.frameAllocBytes = memLastFrameStats[tag].frameAllocBytes;
+    UnlockMemory();
+#endif
+    return stats;
+}
+
+// Set custom allocator for a memory tag, an allocator with alloc == NULL sets back the C library
+// NOTE: Blocks keep being freed by the allocator they came from, so it can be changed at any time
+// WARNING: Allocator calls must not allocate through raylib
+void SetMemoryAllocator(int tag, MemoryAllocator allocator)
+{
+#if defined(SUPPORT_MEMORY_TRACKING)
+    if ((tag < 0) || (tag >= MEMORY_TAG_COUNT)) return;
+
+    if (allocator.alloc == NULL)
+    {
+        LockMemory();
+        memTagAllocator[tag] = 0;
+        UnlockMemory();
+        return;
+    }
+
+    if (allocator.free == NULL) { TRACELOG(LOG_WARNING, "MEMORY: [%s] Allocator requires a free function", GetMemoryTagName(tag)); return; }
+
+    LockMemory();
+    int index = memAllocatorsCount;
+    if (index < MAX_MEMORY_ALLOCATORS)
+    {
+        memAllocators[index] = allocator;
+        memTagAllocator[tag] = index;
+        memAllocatorsCount++;
+    }
+    UnlockMemory();
+
+    if (index < MAX_MEMORY_ALLOCATORS) TRACELOG(LOG_INFO, "MEMORY: [%s] Custom allocator set", GetMemoryTagName(tag));
+    else TRACELOG(LOG_WARNING, "MEMORY: Maximum number of custom allocators reached (%i)", MAX_MEMORY_ALLOCATORS);
+#else
+    (void)tag;
+    (void)allocator;
+    TRACELOG(LOG_WARNING, "MEMORY: Custom allocators require SUPPORT_MEMORY_TRACKING");
+#endif
+}
+
 // Load data from file into a buffer
 unsigned char *LoadFileData(const char *fileName, int *dataSize)
 {
@@ -481,6 +619,167 @@ FILE *android_fopen(const char *fileName, const char *mode)
 }
 #endif  // PLATFORM_ANDROID
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+//----------------------------------------------------------------------------------
+// Module Functions Definition - Memory tracking
+//----------------------------------------------------------------------------------
+
+// Allocate with the allocator of tag and record the block
+void *TrackedAlloc(size_t size, int tag, int zero)
+{
+    if ((tag < 0) || (tag >= MEMORY_TAG_COUNT)) tag = MEMORY_TAG_USER;
+
+    LockMemory();
+
+    // A block the tracker can't record would later be freed by the wrong allocator, fail instead
+    if (!ReserveMemoryBlock())
+    {
+        UnlockMemory();
+        return NULL;
+    }
+
+    int allocator = memTagAllocator[tag];
+    void *ptr = NULL;
+    if (allocator == 0) ptr = zero? calloc(size, 1) : malloc(size);
+    else
+    {
+        ptr = memAllocators[allocator].alloc(memAllocators[allocator].user, (unsigned int)size);
+        if ((ptr != NULL) && zero) memset(ptr, 0, size);
+    }
+
+    if (ptr != NULL) AddMemoryBlock(ptr, size, tag, allocator);
+    UnlockMemory();
+
+    return ptr;
+}
+
+// Reallocate a block, a block raylib didn't allocate is reallocated by the C library and tracked from then on
+// NOTE: The block stays with the tag and allocator it was allocated with
+void *TrackedRealloc(void *ptr, size_t size, int tag)
+{
+    if (ptr == NULL) return TrackedAlloc(size, tag, 0);
+    if (size == 0)
+    {
+        TrackedFree(ptr);
+        return NULL;
+    }
+    if ((tag < 0) || (tag >= MEMORY_TAG_COUNT)) tag = MEMORY_TAG_USER;
+
+    LockMemory();
+
+    // Room for the result before anything moves, on failure the old block is left as it was
+    if (!ReserveMemoryBlock())
+    {
+        UnlockMemory();
+        return NULL;
+    }
+
+    MemoryBlock *block = FindMemoryBlock(ptr);
+    size_t oldSize = 0;
+    int allocator = 0;
+    if (block != NULL)
+    {
+        oldSize = block->size;
+        tag = block->tag;
+        allocator = block->allocator;
+    }
+
+    void *result = NULL;
+    if (allocator == 0) result = realloc(ptr, size);
+    else if (memAllocators[allocator].realloc != NULL) result = memAllocators[allocator].realloc(memAllocators[allocator].user, ptr, (unsigned int)size);
+    else
+    {
+        result = memAllocators[allocator].alloc(memAllocators[allocator].user, (unsigned int)size);
+        if (result != NULL)
+        {
+            memcpy(result, ptr, (oldSize < size)? oldSize : size);
+            memAllocators[allocator].free(memAllocators[allocator].user, ptr);
+        }
+    }
+
+    // On failure the old block is still there
+    if (result != NULL)
+    {
+        if (block != NULL)
+        {
+            RemoveMemoryBlock(block);
+            memTagStats[tag].liveCount--;
+            memTagStats[tag].liveBytes -= oldSize;
+        }
+        AddMemoryBlock(result, size, tag, allocator);
+    }
+    UnlockMemory();
+
+    return result;
+}
+
+// Free a block with the allocator it came from, blocks raylib didn't allocate go to the C library
+void TrackedFree(void *ptr)
+{
+    if (ptr == NULL) return;
+
+    LockMemory();
+    MemoryBlock *block = FindMemoryBlock(ptr);
+    if (block == NULL) free(ptr);
+    else
+    {
+        MemoryTagStats *stats = &memTagStats[block->tag];
+        stats->frameFreeCount++;
+        stats->liveCount--;
+        stats->liveBytes -= block->size;
+
+        int allocator = block->allocator;
+        RemoveMemoryBlock(block);
+        if (allocator == 0) free(ptr);
+        else memAllocators[allocator].free(memAllocators[allocator].user, ptr);
+    }
+    UnlockMemory();
+}
+
+// Close the frame counters, GetMemoryTagStats() reports the frame just finished
+void TrackMemoryFrame(void)
+{
+    LockMemory();
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+    {
+        memLastFrameStats[i] = memTagStats[i];
+        memTagStats[i].frameAllocCount = 0;
+        memTagStats[i].frameFreeCount = 0;
+        memTagStats[i].frameAllocBytes = 0;
+    }
+    UnlockMemory();
+}
+
+// Log the blocks still allocated, whatever is left once everything was unloaded leaked
+void TraceMemoryLeaks(void)
+{
+    MemoryTagStats stats[MEMORY_TAG_COUNT] = { 0 };
+    MemoryBlock leaks[MAX_MEMORY_LEAKS_REPORTED] = { 0 };
+    int leakCount = 0;
+
+    // Copied out, logging can allocate
+    LockMemory();
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++) stats[i] = memTagStats[i];
+    for (size_t i = 0; (i < memBlocksCapacity) && (leakCount < MAX_MEMORY_LEAKS_REPORTED); i++)
+    {
+        if (memBlocks[i].ptr != NULL) leaks[leakCount++] = memBlocks[i];
+    }
+    UnlockMemory();
+
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+    {
+        if (stats[i].liveCount > 0) TRACELOG(LOG_WARNING, "MEMORY: [%s] %u blocks still allocated (%llu bytes, peak %llu bytes)",
+            GetMemoryTagName(i), stats[i].liveCount, stats[i].liveBytes, stats[i].peakBytes);
+        else if (stats[i].peakBytes > 0) TRACELOG(LOG_INFO, "MEMORY: [%s] No leaks (peak %llu bytes)", GetMemoryTagName(i), stats[i].peakBytes);
+    }
+
+    for (int i = 0; i < leakCount; i++)
+    {
+        TRACELOG(LOG_WARNING, "MEMORY: [%s] Leaked %llu bytes at %p", GetMemoryTagName(leaks[i].tag), (unsigned long long)leaks[i].size, leaks[i].ptr);
+    }
+}
+#endif  // SUPPORT_MEMORY_TRACKING
+
 //----------------------------------------------------------------------------------
 // Module specific Functions Definition
 //----------------------------------------------------------------------------------
@@ -508,3 +807,124 @@ static int android_close(void *cookie)
     return 0;
 }
 #endif  // PLATFORM_ANDROID
+
+#if defined(SUPPORT_MEMORY_TRACKING)
+static void LockMemory(void)
+{
+#if defined(_MSC_VER)
+    while (_InterlockedExchange(&memLock, 1) != 0) { }
+#else
+    while (__atomic_exchange_n(&memLock, 1, __ATOMIC_ACQUIRE) != 0) { }
+#endif
+}
+
+static void UnlockMemory(void)
+{
+#if defined(_MSC_VER)
+    _InterlockedExchange(&memLock, 0);
+#else
+    __atomic_store_n(&memLock, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+// Table slot a block address starts probing from
+static size_t MemoryBlockSlot(void *ptr)
+{
+    uintptr_t key = (uintptr_t)ptr >> 4;     // Allocations are at least 16 byte aligned on most platforms
+    return (size_t)(key*0x9E3779B97F4A7C15ull >> 16) & (memBlocksCapacity - 1);
+}
+
+static MemoryBlock *FindMemoryBlock(void *ptr)
+{
+    if (memBlocksCount == 0) return NULL;
+
+    for (size_t i = MemoryBlockSlot(ptr); memBlocks[i].ptr != NULL; i = (i + 1) & (memBlocksCapacity - 1))
+    {
+        if (memBlocks[i].ptr == ptr) return &memBlocks[i];
+    }
+
+    return NULL;
+}
+
+// Keep the table at most 3/4 full, it grows with the C library so it isn't counted itself
+static bool ReserveMemoryBlock(void)
+{
+    if ((memBlocksCount + 1)*4 <= memBlocksCapacity*3) return true;
+
+    size_t capacity = (memBlocksCapacity == 0)? 1024 : memBlocksCapacity*2;
+    MemoryBlock *blocks = (MemoryBlock *)calloc(capacity, sizeof(MemoryBlock));
+    if (blocks == NULL) return false;
+
+    MemoryBlock *oldBlocks = memBlocks;
+    size_t oldCapacity = memBlocksCapacity;
+    memBlocks = blocks;
+    memBlocksCapacity = capacity;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldBlocks[i].ptr == NULL) continue;
+
+        size_t slot = MemoryBlockSlot(oldBlocks[i].ptr);
+        while (memBlocks[slot].ptr != NULL) slot = (slot + 1) & (capacity - 1);
+        memBlocks[slot] = oldBlocks[i];
+    }
+    free(oldBlocks);
+    return true;
+}
+
+// NOTE: ReserveMemoryBlock() made room for it
+static void AddMemoryBlock(void *ptr, size_t size, int tag, int allocator)
+{
+    size_t slot = MemoryBlockSlot(ptr);
+    while ((memBlocks[slot].ptr != NULL) && (memBlocks[slot].ptr != ptr)) slot = (slot + 1) & (memBlocksCapacity - 1);
+
+    // Same address again: the old block was freed behind the tracker's back
+    if (memBlocks[slot].ptr == NULL) memBlocksCount++;
+    else
+    {
+        memTagStats[memBlocks[slot].tag].liveCount--;
+        memTagStats[memBlocks[slot].tag].liveBytes -= memBlocks[slot].size;
+    }
+    memBlocks[slot].ptr = ptr;
+    memBlocks[slot].size = size;
+    memBlocks[slot].tag = (unsigned char)tag;
+    memBlocks[slot].allocator = (unsigned char)allocator;
+
+    MemoryTagStats *stats = &memTagStats[tag];
+    stats->frameAllocCount++;
+    stats->frameAllocBytes += size;
+    stats->liveCount++;
+    stats->liveBytes += size;
+    if (stats->liveBytes > stats->peakBytes) stats->peakBytes = stats->liveBytes;
+}
+
+// Linear probing without tombstones: later blocks of the probe chain move up into the hole
+static void RemoveMemoryBlock(MemoryBlock *block)
+{
+    size_t mask = memBlocksCapacity - 1;
+    size_t hole = (size_t)(block - memBlocks);
+    size_t next = hole;
+
+    for (;;)
+    {
+        memBlocks[hole].ptr = NULL;
+
+        for (;;)
+        {
+            next = (next + 1) & mask;
+            if (memBlocks[next].ptr == NULL)
+            {
+                memBlocksCount--;
+                return;
+            }
+
+            // A block can fill the hole if its home slot isn't cyclically in (hole, next]
+            size_t home = MemoryBlockSlot(memBlocks[next].ptr);
+            bool between = (hole <= next)? ((hole < home) && (home <= next)) : ((hole < home) || (home <= next));
+            if (!between) break;
+        }
+
+        memBlocks[hole] = memBlocks[next];
+        hole = next;
+    }
+}
+#endif  // SUPPORT_MEMORY_TRACKING
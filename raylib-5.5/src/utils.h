@@ -52,6 +52,25 @@
     #define fopen(name, mode) android_fopen(name, mode)
 #endif
 
+// Route the module allocations through the tracker, counted under the tag of the module
+// NOTE: Modules define RL_MEMORY_TAG before including this header, MEMORY_TAG_CORE otherwise
+#if defined(SUPPORT_MEMORY_TRACKING)
+    #include <stddef.h>                     // Required for: size_t
+
+    #ifndef RL_MEMORY_TAG
+        #define RL_MEMORY_TAG MEMORY_TAG_CORE
+    #endif
+
+    #undef RL_MALLOC
+    #undef RL_CALLOC
+    #undef RL_REALLOC
+    #undef RL_FREE
+    #define RL_MALLOC(sz)       TrackedAlloc((size_t)(sz), RL_MEMORY_TAG, 0)
+    #define RL_CALLOC(n,sz)     TrackedAlloc((size_t)(n)*(size_t)(sz), RL_MEMORY_TAG, 1)
+    #define RL_REALLOC(ptr,sz)  TrackedRealloc((ptr), (size_t)(sz), RL_MEMORY_TAG)
+    #define RL_FREE(ptr)        TrackedFree(ptr)
+#endif
+
 //----------------------------------------------------------------------------------
 // Types and Structures Definition
 //----------------------------------------------------------------------------------
@@ -69,6 +88,14 @@
 extern "C" {            // Prevents name mangling of functions
 #endif
 
+#if defined(SUPPORT_MEMORY_TRACKING)
+void *TrackedAlloc(size_t size, int tag, int zero);                    // Allocate with the allocator of tag and record the block
+void *TrackedRealloc(void *ptr, size_t size, int tag);                 // Reallocate a block, untracked blocks become tracked under tag
+void TrackedFree(void *ptr);                                           // Free a block with the allocator it came from
+void TrackMemoryFrame(void);                                           // Close the frame counters, called by EndDrawing()
+void TraceMemoryLeaks(void);                                           // Log the blocks still allocated, called by CloseWindow()
+#endif
+
 #if defined(PLATFORM_ANDROID)
 void InitAssetManager(AAssetManager *manager, const char *dataPath);   // Initialize asset manager from android app
 FILE *android_fopen(const char *fileName, const char *mode);           // Replacement for fopen() -> Read-only!